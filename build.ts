@@ -35,4 +35,15 @@ export default async function (builder: Builder) {
         .addDirectory("cli");
 
     await cli.build();
+
+    const tests = builder
+        .addExecutable("tests")
+        .dependOn(ryuko)
+        .include("tests", "src")
+        .setCXXFlags(...cxxFlags)
+        .setCXXStandard("20")
+        .link("stdc++")
+        .addDirectory("tests");
+
+    await tests.build();
 }
@@ -1,13 +1,250 @@
 #include <ryuko/ryuko.hpp>
 
+namespace {
+
+void usage() {
+  ryuko::error("usage: ryuko <input-file>");
+  ryuko::error("       ryuko --all [--profile fast|release|size] "
+               "[--bundle <file>] <directory | manifest> [output-directory]");
+  ryuko::error("       ryuko --all --transpile <directory | manifest> "
+               "[output-directory]");
+}
+
+bool writeSpirv(const std::filesystem::path &path,
+                const std::vector<uint32_t> &code) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char *>(code.data()),
+            static_cast<std::streamsize>(code.size() * sizeof(uint32_t)));
+
+  if (!out) {
+    ryuko::error("failed to write {}", path.c_str());
+    return false;
+  }
+
+  fmt::println("[ryuko] created {}", path.c_str());
+  return true;
+}
+
+bool writeGlsl(const std::filesystem::path &path, const std::string_view code) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(code.data(), static_cast<std::streamsize>(code.size()));
+
+  if (!out) {
+    ryuko::error("failed to write {}", path.c_str());
+    return false;
+  }
+
+  fmt::println("[ryuko] created {}", path.c_str());
+  return true;
+}
+
+bool writeBundle(const std::filesystem::path &path,
+                 const std::vector<ryuko::compilation::Compiled> &shaders,
+                 const std::filesystem::path &root) {
+  const auto bundle = ryuko::Bundle::pack(shaders, root);
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(bundle.data(), static_cast<std::streamsize>(bundle.size()));
+
+  if (!out) {
+    ryuko::error("failed to write {}", path.c_str());
+    return false;
+  }
+
+  fmt::println("[ryuko] created {}", path.c_str());
+  return true;
+}
+
+//  @note: empty if there is nothing to do, after saying why
+std::vector<std::filesystem::path>
+prepare(const std::filesystem::path &input,
+        const std::filesystem::path &outputDirectory) {
+  auto paths = ryuko::gather(input);
+  if (paths.empty()) {
+    ryuko::error("no shaders in {}", input.c_str());
+    return paths;
+  }
+
+  if (!outputDirectory.empty()) {
+    std::error_code ec;
+    std::filesystem::create_directories(outputDirectory, ec);
+  }
+
+  return paths;
+}
+
+/*
+ *  @note: GLSL goes next to each shader, as <name>_vertex.glsl and
+ *  <name>_fragment.glsl, unless an output directory is given
+ */
+int transpileAll(const std::filesystem::path &input,
+                 const std::filesystem::path &outputDirectory) {
+  const auto paths = prepare(input, outputDirectory);
+  if (paths.empty()) {
+    return 1;
+  }
+
+  size_t failed = 0;
+  const auto results = ryuko::transpilation::transpileAll(
+      paths, std::make_shared<ryuko::IncludeResolver>(),
+      ryuko::WorkerPool::shared(), ryuko::Execution::Parallel);
+
+  for (const auto &transpiled : results) {
+    if (!transpiled.output.has_value()) {
+      ryuko::error("failed to transpile {}", transpiled.path.c_str());
+      failed++;
+      continue;
+    }
+
+    const auto directory = outputDirectory.empty()
+                               ? transpiled.path.parent_path()
+                               : outputDirectory;
+    const auto stem = transpiled.path.stem().string();
+    const auto &sink = transpiled.sink;
+
+    if (!writeGlsl(directory / (stem + "_vertex.glsl"), sink.vertexCode)) {
+      failed++;
+    } else if (!sink.fragmentCode.empty() &&
+               !writeGlsl(directory / (stem + "_fragment.glsl"),
+                          sink.fragmentCode)) {
+      failed++;
+    }
+  }
+
+  fmt::println("[ryuko] transpiled {} of {} shaders", paths.size() - failed,
+               paths.size());
+  return failed ? 1 : 0;
+}
+
+/*
+ *  @note: SPIR-V goes next to each shader unless an output directory is
+ *  given, or in a single bundle
+ */
+int compileAll(const std::filesystem::path &input,
+               const std::filesystem::path &outputDirectory,
+               const ryuko::compilation::Profile profile,
+               const std::filesystem::path &bundle) {
+  const auto paths = prepare(input, outputDirectory);
+  if (paths.empty()) {
+    return 1;
+  }
+
+  size_t failed = 0;
+  const auto results = ryuko::compilation::compileAll(
+      paths, std::make_shared<ryuko::IncludeResolver>(),
+      ryuko::WorkerPool::shared(), ryuko::Execution::Parallel, profile);
+
+  for (const auto &compiled : results) {
+    if (!compiled.succeeded()) {
+      ryuko::error("failed to compile {}", compiled.path.c_str());
+      failed++;
+      continue;
+    }
+
+    if (!bundle.empty()) {
+      continue;
+    }
+
+    const auto directory = outputDirectory.empty()
+                               ? compiled.path.parent_path()
+                               : outputDirectory;
+    const auto stem = compiled.path.stem().string();
+    const auto &spirv = compiled.sink.spirv;
+
+    if (!writeSpirv(directory / (stem + ".vert.spv"),
+                    spirv.vertexCode.value())) {
+      failed++;
+    } else if (spirv.fragmentCode.has_value() &&
+               !writeSpirv(directory / (stem + ".frag.spv"),
+                           spirv.fragmentCode.value())) {
+      failed++;
+    }
+  }
+
+  if (!bundle.empty()) {
+    //  @note: pipelines are named relative to the directory or manifest
+    const auto root = std::filesystem::is_directory(input)
+                          ? input
+                          : input.parent_path();
+
+    if (!writeBundle(bundle, results, root)) {
+      return 1;
+    }
+  }
+
+  fmt::println("[ryuko] compiled {} of {} shaders", paths.size() - failed,
+               paths.size());
+  return failed ? 1 : 0;
+}
+
+} // namespace
+
 int main(const int argc, char **argv) {
   if (argc < 2) {
-    ryuko::error("usage: ryuko <input-file>");
+    usage();
+    return 1;
+  }
+
+  if (std::string_view{argv[1]} == "--all") {
+    int next = 2;
+
+    auto profile = ryuko::compilation::Profile::Release;
+    std::filesystem::path bundle{};
+    bool transpile = false;
+    bool compileOptions = false;
+
+    while (next + 1 < argc) {
+      const std::string_view option{argv[next]};
+
+      if (option == "--transpile") {
+        transpile = true;
+        next++;
+      } else if (option == "--profile") {
+        const auto selected = ryuko::compilation::profile(argv[next + 1]);
+        if (!selected.has_value()) {
+          ryuko::error("unknown profile {}", argv[next + 1]);
+          usage();
+          return 1;
+        }
+
+        profile = selected.value();
+        compileOptions = true;
+        next += 2;
+      } else if (option == "--bundle") {
+        bundle = argv[next + 1];
+        compileOptions = true;
+        next += 2;
+      } else {
+        break;
+      }
+    }
+
+    //  @note: --profile and --bundle only apply to SPIR-V
+    if (next >= argc || (transpile && compileOptions)) {
+      usage();
+      return 1;
+    }
+
+    if (transpile) {
+      return transpileAll(argv[next], next + 1 < argc ? argv[next + 1] : "");
+    }
+
+    return compileAll(argv[next], next + 1 < argc ? argv[next + 1] : "",
+                      profile, bundle);
+  }
+
+  ryuko::transpilation::FileSink sink;
+  if (!ryuko::transpilation::transpile(argv[1], sink).has_value()) {
     return 1;
   }
 
-  if (auto result = ryuko::transpile(argv[1]); result.has_value()) {
-    fmt::println("[ryuko] created {}", result.value().fragment);
-    fmt::println("[ryuko] created {}", result.value().vertex);
+  const std::filesystem::path path{argv[1]};
+  const auto stem = path.stem().string();
+
+  fmt::println("[ryuko] created {}",
+               (path.parent_path() / (stem + "_vertex.glsl")).c_str());
+  if (sink.hasFragmentCode()) {
+    fmt::println("[ryuko] created {}",
+                 (path.parent_path() / (stem + "_fragment.glsl")).c_str());
   }
-}
\ No newline at end of file
+}
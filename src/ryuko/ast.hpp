@@ -0,0 +1,799 @@
+#pragma once
+
+#include <ryuko/pch.hpp>
+
+#include <ryuko/keywords.hpp>
+#include <ryuko/lexer.hpp>
+
+namespace ryuko {
+
+/*
+ *  Flat syntax tree of a function body. Nodes live in one vector and refer to
+ *  each other by index, children are chained through nextSibling, so a pass
+ *  over every node of a kind is a plain linear scan.
+ *
+ *  @note: offsets are relative to the body the tree was built from, which
+ *  has to outlive any text() taken from it
+ */
+struct Ast {
+  using allocator_type = std::pmr::polymorphic_allocator<>;
+  using Index = uint32_t;
+
+  static constexpr Index None = std::numeric_limits<Index>::max();
+
+  enum class Kind : uint8_t {
+    //  statements
+    Block,
+    Declaration,
+    Declarator,
+    If,
+    For,
+    While,
+    DoWhile,
+    Switch,
+    Case,
+    Default,
+    Return,
+    Break,
+    Continue,
+    Discard,
+    Expression,
+    Empty,
+    Directive,
+    Unknown,
+
+    //  expressions
+    Identifier,
+    Literal,
+    Call,
+    Member,
+    Subscript,
+    Unary,
+    Postfix,
+    Binary,
+    Assignment,
+    Conditional,
+    Sequence,
+    InitializerList,
+  };
+
+  /*
+   *  [begin, end) spans the whole node, token names it: the identifier,
+   *  literal, operator, declared type or called function.
+   *
+   *  Children by kind:
+   *    Declaration: Declarator...         Declarator: [size], [initializer]
+   *    If: condition, then, [else]        For: init, condition, step, body
+   *    While: condition, body             DoWhile: body, condition
+   *    Switch: value, Block               Case: value
+   *    Return: [value]                    Expression: expression
+   *    Call: callee, arguments...         Member: object
+   *    Subscript: object, index           Unary, Postfix: operand
+   *    Binary, Assignment: lhs, rhs       Conditional: condition, then, else
+   */
+  struct Node {
+    Kind kind;
+    uint32_t begin = 0;
+    uint32_t end = 0;
+    uint32_t token = 0;
+    uint32_t tokenLength = 0;
+    Index firstChild = None;
+    Index nextSibling = None;
+  };
+
+public:
+  std::pmr::vector<Node> nodes;
+  Index root = None;
+
+public:
+  Ast() = default;
+
+  explicit Ast(const allocator_type &allocator) : nodes(allocator) {}
+
+  Ast(const Ast &other, const allocator_type &allocator)
+      : nodes(other.nodes, allocator), root(other.root) {}
+
+  Ast(Ast &&other, const allocator_type &allocator)
+      : nodes(std::move(other.nodes), allocator), root(other.root) {}
+
+public:
+  [[nodiscard]] static Ast parse(std::string_view body,
+                                 const allocator_type &allocator = {});
+
+  [[nodiscard]] bool empty() const { return root == None; }
+
+  [[nodiscard]] const Node &operator[](const Index index) const {
+    return nodes[index];
+  }
+
+  [[nodiscard]] static std::string_view text(const Node &node,
+                                             const std::string_view source) {
+    return source.substr(node.token, node.tokenLength);
+  }
+
+  [[nodiscard]] static std::string_view span(const Node &node,
+                                             const std::string_view source) {
+    return source.substr(node.begin, node.end - node.begin);
+  }
+
+  [[nodiscard]] Index child(const Index parent, size_t n) const {
+    auto index = nodes[parent].firstChild;
+    while (n-- && index != None) {
+      index = nodes[index].nextSibling;
+    }
+
+    return index;
+  }
+
+  [[nodiscard]] Index lastChild(const Index parent) const {
+    auto index = nodes[parent].firstChild;
+    while (index != None && nodes[index].nextSibling != None) {
+      index = nodes[index].nextSibling;
+    }
+
+    return index;
+  }
+
+  //  @note: the variable an lvalue ultimately refers to, `a.b[i].c` -> `a`
+  [[nodiscard]] Index target(Index index) const {
+    while (index != None && (nodes[index].kind == Kind::Member ||
+                             nodes[index].kind == Kind::Subscript)) {
+      index = nodes[index].firstChild;
+    }
+
+    return index != None && nodes[index].kind == Kind::Identifier ? index
+                                                                  : None;
+  }
+
+  //  @note: assignments, compound assignments and increments count as writes
+  [[nodiscard]] bool writes(const std::string_view name,
+                            const std::string_view source) const {
+    for (const auto &node : nodes) {
+      const bool write =
+          node.kind == Kind::Assignment ||
+          ((node.kind == Kind::Unary || node.kind == Kind::Postfix) &&
+           (text(node, source) == "++" || text(node, source) == "--"));
+      if (!write) {
+        continue;
+      }
+
+      if (const auto variable = target(node.firstChild);
+          variable != None && text(nodes[variable], source) == name) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+};
+
+/*
+ *  Recursive descent over a function body, statements by keyword and
+ *  expressions by precedence climbing. Statements it cannot make sense of
+ *  are kept as Unknown nodes spanning up to the next ';' or closing '}', so
+ *  one odd construct never costs the rest of the body.
+ */
+struct AstParser {
+private:
+  Lexer lexer;
+  Ast &ast;
+  bool failed = false;
+
+public:
+  AstParser(const std::string_view body, Ast &ast) : lexer(body), ast(ast) {}
+
+public:
+  //  @note: body runs from after the opening '{' through the closing '}'
+  void parse() {
+    const auto begin = lexer.offset();
+
+    Ast::Index first = Ast::None, last = Ast::None;
+    while (!lexer.peek().end() && !lexer.peek().is('}')) {
+      append(first, last, statement());
+    }
+
+    lexer.next();
+    ast.root = add(Ast::Kind::Block, begin, lexer.offset());
+    ast.nodes[ast.root].firstChild = first;
+  }
+
+private:
+  [[nodiscard]] static uint32_t offset(const size_t value) {
+    return static_cast<uint32_t>(value);
+  }
+
+  Ast::Index add(const Ast::Kind kind, const size_t begin, const size_t end,
+                 const Token &token = {}) {
+    ast.nodes.push_back(Ast::Node{
+        .kind = kind,
+        .begin = offset(begin),
+        .end = offset(end),
+        .token = offset(token.end() ? begin
+                                    : token.text.data() - source().data()),
+        .tokenLength = offset(token.text.size()),
+    });
+
+    return static_cast<Ast::Index>(ast.nodes.size() - 1);
+  }
+
+  Ast::Index parent(const Ast::Kind kind, const size_t begin,
+                    const Token &token,
+                    std::initializer_list<Ast::Index> children) {
+    const auto index = add(kind, begin, lexer.offset(), token);
+
+    Ast::Index first = Ast::None, last = Ast::None;
+    for (const auto child : children) {
+      append(first, last, child);
+    }
+
+    ast.nodes[index].firstChild = first;
+    return index;
+  }
+
+  void append(Ast::Index &first, Ast::Index &last, const Ast::Index child) {
+    if (child == Ast::None) {
+      return;
+    }
+
+    if (last == Ast::None) {
+      first = child;
+    } else {
+      ast.nodes[last].nextSibling = child;
+    }
+
+    last = child;
+  }
+
+  [[nodiscard]] std::string_view source() const { return lexer.source(); }
+
+  [[nodiscard]] uint32_t begin(const Ast::Index index) const {
+    return ast.nodes[index].begin;
+  }
+
+  [[nodiscard]] static Keyword keyword(const Token &token) {
+    return token.kind == Token::Kind::Identifier ? keywords::lookup(token.text)
+                                                 : Keyword::None;
+  }
+
+  //  @note: the rest of the keyword table is fair game as a variable name
+  [[nodiscard]] static bool reserved(const Token &token) {
+    const auto value = keyword(token);
+    return value >= Keyword::If && value <= Keyword::Discard;
+  }
+
+  bool accept(const char c) {
+    if (lexer.peek().is(c)) {
+      lexer.next();
+      return true;
+    }
+
+    return false;
+  }
+
+  void expect(const char c) {
+    if (!accept(c)) {
+      failed = true;
+    }
+  }
+
+  Ast::Index statement() {
+    const auto start = lexer.peek().offset;
+    const auto mark = ast.nodes.size();
+
+    //  @note: the enclosing statement, e.g. an `if` missing its '(', fails
+    //  on its own once this nested one is parsed
+    const bool enclosingFailed = std::exchange(failed, false);
+
+    auto index = statementOrFail();
+    if (!failed) {
+      failed = enclosingFailed;
+      return index;
+    }
+
+    failed = enclosingFailed;
+    ast.nodes.resize(mark);
+    lexer.rewind(start);
+    recover();
+
+    return add(Ast::Kind::Unknown, start, lexer.offset());
+  }
+
+  //  @note: up to and including the next ';' of this scope, stopping in
+  //  front of the '}' closing the enclosing one
+  void recover() {
+    size_t depth = 0;
+
+    while (true) {
+      const auto token = lexer.peek();
+      if (token.end() || (depth == 0 && token.is('}'))) {
+        return;
+      }
+
+      lexer.next();
+
+      if (token.is('(') || token.is('[') || token.is('{')) {
+        depth++;
+      } else if (token.is(')') || token.is(']') || token.is('}')) {
+        if (depth) {
+          depth--;
+        }
+      } else if (depth == 0 && token.is(';')) {
+        return;
+      }
+    }
+  }
+
+  Ast::Index statementOrFail() {
+    const auto token = lexer.peek();
+
+    if (token.kind == Token::Kind::Directive) {
+      lexer.next();
+      return add(Ast::Kind::Directive, token.offset, lexer.offset(), token);
+    }
+
+    if (token.is('{')) {
+      return block();
+    }
+
+    if (token.is(';')) {
+      lexer.next();
+      return add(Ast::Kind::Empty, token.offset, lexer.offset());
+    }
+
+    switch (keyword(token)) {
+    case Keyword::If: {
+      lexer.next();
+      expect('(');
+      const auto condition = expression();
+      expect(')');
+      const auto then = statement();
+
+      auto otherwise = Ast::None;
+      if (keyword(lexer.peek()) == Keyword::Else) {
+        lexer.next();
+        otherwise = statement();
+      }
+
+      return parent(Ast::Kind::If, token.offset, token,
+                    {condition, then, otherwise});
+    }
+    case Keyword::For: {
+      lexer.next();
+      expect('(');
+
+      Ast::Index init;
+      if (declarationAhead()) {
+        init = declaration();
+      } else if (const auto empty = lexer.peek(); accept(';')) {
+        init = add(Ast::Kind::Empty, empty.offset, lexer.offset());
+      } else {
+        init = expressionStatement();
+      }
+
+      const auto condition = lexer.peek().is(';')
+                                 ? add(Ast::Kind::Empty, lexer.peek().offset,
+                                       lexer.peek().offset)
+                                 : expression();
+      expect(';');
+
+      const auto step = lexer.peek().is(')')
+                            ? add(Ast::Kind::Empty, lexer.peek().offset,
+                                  lexer.peek().offset)
+                            : expression();
+      expect(')');
+
+      const auto body = statement();
+      return parent(Ast::Kind::For, token.offset, token,
+                    {init, condition, step, body});
+    }
+    case Keyword::While: {
+      lexer.next();
+      expect('(');
+      const auto condition = expression();
+      expect(')');
+      const auto body = statement();
+
+      return parent(Ast::Kind::While, token.offset, token, {condition, body});
+    }
+    case Keyword::Do: {
+      lexer.next();
+      const auto body = statement();
+      if (keyword(lexer.next()) != Keyword::While) {
+        failed = true;
+      }
+
+      expect('(');
+      const auto condition = expression();
+      expect(')');
+      expect(';');
+
+      return parent(Ast::Kind::DoWhile, token.offset, token,
+                    {body, condition});
+    }
+    case Keyword::Switch: {
+      lexer.next();
+      expect('(');
+      const auto value = expression();
+      expect(')');
+
+      if (!lexer.peek().is('{')) {
+        failed = true;
+        return Ast::None;
+      }
+
+      const auto body = block();
+      return parent(Ast::Kind::Switch, token.offset, token, {value, body});
+    }
+    case Keyword::Case: {
+      lexer.next();
+      const auto value = conditional();
+      expect(':');
+
+      return parent(Ast::Kind::Case, token.offset, token, {value});
+    }
+    case Keyword::Default:
+      lexer.next();
+      expect(':');
+      return add(Ast::Kind::Default, token.offset, lexer.offset(), token);
+    case Keyword::Return: {
+      lexer.next();
+      const auto value = lexer.peek().is(';') ? Ast::None : expression();
+      expect(';');
+
+      return parent(Ast::Kind::Return, token.offset, token, {value});
+    }
+    case Keyword::Break:
+    case Keyword::Continue:
+    case Keyword::Discard: {
+      lexer.next();
+      expect(';');
+
+      const auto kind = keyword(token) == Keyword::Break ? Ast::Kind::Break
+                        : keyword(token) == Keyword::Continue
+                            ? Ast::Kind::Continue
+                            : Ast::Kind::Discard;
+      return add(kind, token.offset, lexer.offset(), token);
+    }
+    default:
+      break;
+    }
+
+    if (declarationAhead()) {
+      return declaration();
+    }
+
+    return expressionStatement();
+  }
+
+  Ast::Index block() {
+    const auto open = lexer.next();
+
+    Ast::Index first = Ast::None, last = Ast::None;
+    while (!lexer.peek().end() && !lexer.peek().is('}')) {
+      append(first, last, statement());
+    }
+
+    expect('}');
+
+    const auto index = add(Ast::Kind::Block, open.offset, lexer.offset());
+    ast.nodes[index].firstChild = first;
+    return index;
+  }
+
+  Ast::Index expressionStatement() {
+    const auto start = lexer.peek().offset;
+    const auto value = expression();
+    expect(';');
+
+    return parent(Ast::Kind::Expression, start, {}, {value});
+  }
+
+  //  @note: a qualifier, `type name` or `type[size] name`
+  [[nodiscard]] bool declarationAhead() {
+    const auto first = lexer.peek();
+    if (keywords::qualifier(keyword(first))) {
+      return true;
+    }
+
+    if (first.kind != Token::Kind::Identifier || reserved(first)) {
+      return false;
+    }
+
+    const auto start = lexer.offset();
+    lexer.next();
+
+    auto second = lexer.next();
+    if (second.is('[')) {
+      for (size_t depth = 1; depth && !second.end();) {
+        second = lexer.next();
+        if (second.is('[')) {
+          ++depth;
+        } else if (second.is(']') && depth > 0) {
+          --depth;
+        }
+      }
+
+      second = lexer.next();
+    }
+
+    lexer.rewind(start);
+
+    return second.kind == Token::Kind::Identifier;
+  }
+
+  Ast::Index declaration() {
+    const auto start = lexer.peek().offset;
+    while (keywords::qualifier(keyword(lexer.peek()))) {
+      lexer.next();
+    }
+
+    const auto type = lexer.next();
+    if (type.kind != Token::Kind::Identifier) {
+      failed = true;
+      return Ast::None;
+    }
+
+    //  @note: the size of an array type is parsed but left unlinked
+    if (accept('[')) {
+      if (!accept(']')) {
+        expression();
+        expect(']');
+      }
+    }
+
+    Ast::Index first = Ast::None, last = Ast::None;
+    do {
+      const auto name = lexer.next();
+      if (name.kind != Token::Kind::Identifier) {
+        failed = true;
+        return Ast::None;
+      }
+
+      auto size = Ast::None;
+      if (accept('[')) {
+        size = lexer.peek().is(']') ? Ast::None : expression();
+        expect(']');
+      }
+
+      auto initializer = Ast::None;
+      if (accept('=')) {
+        initializer = assignment();
+      }
+
+      append(first, last,
+             parent(Ast::Kind::Declarator, name.offset, name,
+                    {size, initializer}));
+    } while (!failed && accept(','));
+
+    expect(';');
+
+    const auto index = add(Ast::Kind::Declaration, start, lexer.offset(), type);
+    ast.nodes[index].firstChild = first;
+    return index;
+  }
+
+  Ast::Index expression() {
+    const auto value = assignment();
+    if (!lexer.peek().is(',')) {
+      return value;
+    }
+
+    Ast::Index first = Ast::None, last = Ast::None;
+    append(first, last, value);
+    while (!failed && accept(',')) {
+      append(first, last, assignment());
+    }
+
+    const auto index = add(Ast::Kind::Sequence, begin(value), lexer.offset());
+    ast.nodes[index].firstChild = first;
+    return index;
+  }
+
+  [[nodiscard]] static bool assignmentOperator(const Token &token) {
+    static constexpr std::string_view operators[] = {
+        "=", "+=", "-=", "*=", "/=", "%=", "<<=", ">>=", "&=", "^=", "|=",
+    };
+
+    return token.kind == Token::Kind::Punctuation &&
+           std::ranges::find(operators, token.text) != std::end(operators);
+  }
+
+  Ast::Index assignment() {
+    const auto lhs = conditional();
+    if (failed || !assignmentOperator(lexer.peek())) {
+      return lhs;
+    }
+
+    const auto op = lexer.next();
+    const auto rhs = assignment();
+
+    return parent(Ast::Kind::Assignment, begin(lhs), op, {lhs, rhs});
+  }
+
+  Ast::Index conditional() {
+    const auto condition = binary(1);
+    if (failed || !lexer.peek().is('?')) {
+      return condition;
+    }
+
+    const auto op = lexer.next();
+    const auto then = expression();
+    expect(':');
+    const auto otherwise = assignment();
+
+    return parent(Ast::Kind::Conditional, begin(condition), op,
+                  {condition, then, otherwise});
+  }
+
+  [[nodiscard]] static int precedence(const Token &token) {
+    if (token.kind != Token::Kind::Punctuation) {
+      return 0;
+    }
+
+    static constexpr std::pair<std::string_view, int> operators[] = {
+        {"||", 1},  {"^^", 2},  {"&&", 3}, {"|", 4},  {"^", 5},  {"&", 6},
+        {"==", 7},  {"!=", 7},  {"<", 8},  {">", 8},  {"<=", 8}, {">=", 8},
+        {"<<", 9},  {">>", 9},  {"+", 10}, {"-", 10}, {"*", 11}, {"/", 11},
+        {"%", 11},
+    };
+
+    for (const auto &[op, value] : operators) {
+      if (token.text == op) {
+        return value;
+      }
+    }
+
+    return 0;
+  }
+
+  Ast::Index binary(const int minimum) {
+    auto lhs = unary();
+
+    while (!failed) {
+      const auto op = lexer.peek();
+      const auto value = precedence(op);
+      if (value < minimum || value == 0) {
+        break;
+      }
+
+      lexer.next();
+      const auto rhs = binary(value + 1);
+      lhs = parent(Ast::Kind::Binary, begin(lhs), op, {lhs, rhs});
+    }
+
+    return lhs;
+  }
+
+  Ast::Index unary() {
+    const auto token = lexer.peek();
+    if (token.is('+') || token.is('-') || token.is('!') || token.is('~') ||
+        (token.kind == Token::Kind::Punctuation &&
+         (token.text == "++" || token.text == "--"))) {
+      lexer.next();
+      const auto operand = unary();
+
+      return parent(Ast::Kind::Unary, token.offset, token, {operand});
+    }
+
+    return postfix();
+  }
+
+  Ast::Index postfix() {
+    auto value = primary();
+
+    while (!failed) {
+      const auto token = lexer.peek();
+
+      if (token.is('(')) {
+        lexer.next();
+
+        Ast::Index first = Ast::None, last = Ast::None;
+        append(first, last, value);
+        if (!accept(')')) {
+          do {
+            append(first, last, assignment());
+          } while (!failed && accept(','));
+          expect(')');
+        }
+
+        //  @note: copied, add() may reallocate the nodes
+        const auto callee = ast.nodes[value];
+        const auto index = add(Ast::Kind::Call, callee.begin, lexer.offset());
+        ast.nodes[index].token = callee.token;
+        ast.nodes[index].tokenLength =
+            callee.kind == Ast::Kind::Identifier ? callee.tokenLength : 0;
+        ast.nodes[index].firstChild = first;
+        value = index;
+      } else if (token.is('[')) {
+        lexer.next();
+        const auto index = expression();
+        expect(']');
+
+        value =
+            parent(Ast::Kind::Subscript, begin(value), token, {value, index});
+      } else if (token.is('.')) {
+        lexer.next();
+        const auto field = lexer.next();
+        if (field.kind != Token::Kind::Identifier) {
+          failed = true;
+          break;
+        }
+
+        value = parent(Ast::Kind::Member, begin(value), field, {value});
+      } else if (token.kind == Token::Kind::Punctuation &&
+                 (token.text == "++" || token.text == "--")) {
+        lexer.next();
+        value = parent(Ast::Kind::Postfix, begin(value), token, {value});
+      } else {
+        break;
+      }
+    }
+
+    return value;
+  }
+
+  Ast::Index primary() {
+    const auto token = lexer.next();
+
+    switch (token.kind) {
+    case Token::Kind::Identifier:
+      if (reserved(token)) {
+        break;
+      }
+
+      return add(Ast::Kind::Identifier, token.offset, lexer.offset(), token);
+    case Token::Kind::Number:
+      return add(Ast::Kind::Literal, token.offset, lexer.offset(), token);
+    case Token::Kind::Punctuation:
+      if (token.is('(')) {
+        const auto inner = expression();
+        expect(')');
+
+        if (failed) {
+          return inner;
+        }
+
+        //  @note: keep the parentheses in the span so it can be copied as is
+        ast.nodes[inner].begin = offset(token.offset);
+        ast.nodes[inner].end = offset(lexer.offset());
+        return inner;
+      }
+
+      if (token.is('{')) {
+        Ast::Index first = Ast::None, last = Ast::None;
+        if (!accept('}')) {
+          do {
+            if (lexer.peek().is('}')) {
+              break;
+            }
+
+            append(first, last, assignment());
+          } while (!failed && accept(','));
+          expect('}');
+        }
+
+        const auto index =
+            add(Ast::Kind::InitializerList, token.offset, lexer.offset());
+        ast.nodes[index].firstChild = first;
+        return index;
+      }
+      break;
+    default:
+      break;
+    }
+
+    failed = true;
+    return add(Ast::Kind::Unknown, token.offset, lexer.offset());
+  }
+};
+
+inline Ast Ast::parse(const std::string_view body,
+                      const allocator_type &allocator) {
+  Ast ast{allocator};
+  ast.nodes.reserve(body.size() / 8);
+
+  AstParser{body, ast}.parse();
+  return ast;
+}
+
+} // namespace ryuko
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <ryuko/compile.hpp>
+#include <ryuko/pool.hpp>
+
+namespace ryuko::compilation {
+
+/*
+ *  A compilation running on a worker pool. Poll ready() to keep drawing with
+ *  a fallback until the shader is there, block in wait(), or co_await it from
+ *  a coroutine.
+ *
+ *  @note: the Sink is written from a worker, leave it alone until ready().
+ *  It must outlive the compilation even if this handle is dropped.
+ */
+class Pending final {
+  struct State {
+    std::mutex mutex;
+    bool done = false;
+    Optional<Output> output;
+    std::coroutine_handle<> waiter;
+  };
+
+  std::shared_ptr<State> state;
+  WorkerPool::Task<void> finished;
+  WorkerPool *pool = nullptr;
+
+public:
+  Pending() = default;
+
+  template <typename F>
+  [[nodiscard]] static Pending start(WorkerPool &pool, F &&job) {
+    Pending pending;
+    pending.pool = &pool;
+    pending.state = std::make_shared<State>();
+
+    pending.finished =
+        pool.submit([state = pending.state, job = std::forward<F>(job)] {
+          auto output = run(job);
+
+          std::coroutine_handle<> waiter;
+          {
+            std::lock_guard lock{state->mutex};
+            state->output = std::move(output);
+            state->done = true;
+            waiter = std::exchange(state->waiter, nullptr);
+          }
+
+          //  @note: the awaiting coroutine continues on this thread, a
+          //  worker unless wait() ran the job first
+          if (waiter) {
+            waiter.resume();
+          }
+        });
+
+    return pending;
+  }
+
+private:
+  //  @note: a job that throws finishes with no output, so nothing waits on
+  //  it forever
+  template <typename F> static Optional<Output> run(F &job) {
+#ifdef USE_EXCEPTIONS
+    try {
+      return job();
+    } catch (const std::exception &exception) {
+      error("[async] compilation failed: {}", exception.what());
+    } catch (...) {
+      error("[async] compilation failed with an unknown exception");
+    }
+
+    return {};
+#else
+    return job();
+#endif
+  }
+
+public:
+  [[nodiscard]] bool valid() const { return state != nullptr; }
+
+  [[nodiscard]] bool ready() const {
+    if (!state) {
+      return false;
+    }
+
+    std::lock_guard lock{state->mutex};
+    return state->done;
+  }
+
+  /*
+   *  @note: runs the compilation here if no worker started it yet. An
+   *  invalid handle has nothing to wait for and no output.
+   */
+  Optional<Output> &wait() {
+    if (!state) {
+      static thread_local Optional<Output> none;
+      none.reset();
+      return none;
+    }
+
+    if (finished.valid()) {
+      pool->wait(finished);
+    }
+
+    return state->output;
+  }
+
+public:
+  //  @note: an invalid handle resumes right away with no output
+  [[nodiscard]] bool await_ready() const { return !state || ready(); }
+
+  bool await_suspend(const std::coroutine_handle<> handle) {
+    if (!state) {
+      return false;
+    }
+
+    std::lock_guard lock{state->mutex};
+    if (state->done) {
+      return false;
+    }
+
+    state->waiter = handle;
+    return true;
+  }
+
+  Optional<Output> await_resume() {
+    if (!state) {
+      return {};
+    }
+
+    std::lock_guard lock{state->mutex};
+    return std::move(state->output);
+  }
+};
+
+/*
+ *  compile() off the calling thread: reading, parsing, shaderc and creating
+ *  the shader modules all run as one job on the pool.
+ */
+[[maybe_unused]]
+static Pending
+compileAsync(std::filesystem::path path, Sink &sink, const VkDevice device,
+             std::shared_ptr<IncludeResolver> resolver =
+                 std::make_shared<IncludeResolver>(),
+             WorkerPool &pool = WorkerPool::shared(),
+             const Execution execution = Execution::Serial,
+             const Profile profile = Profile::Release) {
+  return Pending::start(pool, [path = std::move(path), &sink, device,
+                               resolver = std::move(resolver), execution,
+                               profile] {
+    return compile(path, sink, device, resolver, execution, profile);
+  });
+}
+
+//  @note: takes the source by value, the job outlives the caller's copy
+[[maybe_unused]]
+static Pending
+compileAsync(std::string source, std::filesystem::path path, Sink &sink,
+             const VkDevice device,
+             std::shared_ptr<IncludeResolver> resolver =
+                 std::make_shared<IncludeResolver>(),
+             WorkerPool &pool = WorkerPool::shared(),
+             const Execution execution = Execution::Serial,
+             const Profile profile = Profile::Release) {
+  return Pending::start(pool, [source = std::move(source),
+                               path = std::move(path), &sink, device,
+                               resolver = std::move(resolver), execution,
+                               profile] {
+    return compile(std::string_view{source}, path, sink, device, resolver,
+                   execution, profile);
+  });
+}
+
+} // namespace ryuko::compilation
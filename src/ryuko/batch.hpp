@@ -0,0 +1,185 @@
+#pragma once
+
+#include <ryuko/compile.hpp>
+#include <ryuko/pool.hpp>
+#include <ryuko/transpile.hpp>
+
+namespace ryuko {
+
+/*
+ *  The shaders a batch is made of. A directory yields its `.glsl` files, not
+ *  descending into subdirectories so include libraries can live there. Any
+ *  other file is a manifest: one shader path per line, relative to the
+ *  manifest, blank lines and lines starting with `#` are skipped.
+ *
+ *  @note: empty if the input cannot be read
+ */
+[[maybe_unused]]
+static std::vector<std::filesystem::path>
+gather(const std::filesystem::path &input) {
+  std::vector<std::filesystem::path> paths;
+
+  std::error_code ec;
+  if (std::filesystem::is_directory(input, ec)) {
+    for (const auto &entry : std::filesystem::directory_iterator(input, ec)) {
+      if (entry.is_regular_file(ec) && entry.path().extension() == ".glsl") {
+        paths.push_back(entry.path());
+      }
+    }
+
+    if (ec) {
+      error("failed to list {}: {}", input.c_str(), ec.message());
+    }
+
+    std::ranges::sort(paths);
+    return paths;
+  }
+
+  const auto manifest = SourceFile::open(input);
+  if (!manifest.has_value()) {
+    error("failed to open manifest {}", input.c_str());
+    return paths;
+  }
+
+  auto rest = manifest->content();
+  while (!rest.empty()) {
+    const auto end = std::min(rest.find('\n'), rest.size());
+    auto line = rest.substr(0, end);
+    rest.remove_prefix(std::min(end + 1, rest.size()));
+
+    line.remove_prefix(std::min(line.find_first_not_of(" \t\r"), line.size()));
+    line = line.substr(0, line.find_last_not_of(" \t\r") + 1);
+
+    if (!line.empty() && !line.starts_with('#')) {
+      paths.push_back(input.parent_path() / line);
+    }
+  }
+
+  return paths;
+}
+
+} // namespace ryuko
+
+namespace ryuko::transpilation {
+
+struct Transpiled {
+  std::filesystem::path path;
+  Optional<Output> output;
+  MemorySink sink;
+};
+
+/*
+ *  Transpiles every shader as one job on the pool. The jobs share the
+ *  resolver, so a file included by many shaders is read once, and the
+ *  process-wide include cache, so it is parsed once.
+ *
+ *  A shader's parse and emission depend on each other and stay in its job.
+ *  With Execution::Parallel its fragment stage is emitted as a job of its
+ *  own, so a large shader does not keep a single worker to itself.
+ *
+ *  @note: results are in the order of `paths`
+ */
+[[maybe_unused]]
+static std::vector<Transpiled>
+transpileAll(const std::span<const std::filesystem::path> paths,
+             const std::shared_ptr<IncludeResolver> &resolver =
+                 std::make_shared<IncludeResolver>(),
+             WorkerPool &pool = WorkerPool::shared(),
+             const Execution execution = Execution::Serial) {
+  std::vector<Transpiled> results(paths.size());
+  std::vector<WorkerPool::Task<void>> pending;
+  pending.reserve(paths.size());
+
+  for (size_t i = 0; i < paths.size(); i++) {
+    pending.push_back(
+        pool.submit([&result = results[i], &path = paths[i], &resolver,
+                     execution] {
+          result.path = path;
+          result.output = transpile(path, result.sink, resolver, execution);
+        }));
+  }
+
+  for (auto &job : pending) {
+    pool.wait(job);
+  }
+
+  return results;
+}
+
+} // namespace ryuko::transpilation
+
+namespace ryuko::compilation {
+
+//  @note: keeps the SPIR-V instead of creating shader modules
+struct SpirvSink final : Sink {
+  std::filesystem::path path;
+  ShaderCompilationResult spirv;
+
+public:
+  void write(const std::filesystem::path &path, const Emitter::Output &code,
+             [[maybe_unused]] const VkDevice device,
+             const WriteOptions &options) override {
+    this->path = path;
+    expect(code);
+    this->spirv = compile(path, code, options.resolver, options.execution,
+                          CompilerContext::local(options.profile));
+  }
+
+  [[nodiscard]] bool succeeded() const override {
+    return spirv.vertexCode.has_value() &&
+           (!expectsFragment || spirv.fragmentCode.has_value());
+  }
+};
+
+struct Compiled {
+  std::filesystem::path path;
+  Optional<Output> output;
+  SpirvSink sink;
+
+public:
+  [[nodiscard]] bool succeeded() const {
+    return output.has_value() && sink.succeeded();
+  }
+};
+
+/*
+ *  Compiles every shader to SPIR-V as one job on the pool. Besides the
+ *  resolver and the include cache, the jobs share the CompilerContext of the
+ *  worker they run on, and the SPIR-V cache.
+ *
+ *  Parsing, emission and compilation of a shader run in order in its job.
+ *  With Execution::Parallel its two stages are emitted and compiled as jobs
+ *  of their own, which idle workers steal.
+ *
+ *  @note: results are in the order of `paths`
+ */
+[[maybe_unused]]
+static std::vector<Compiled>
+compileAll(const std::span<const std::filesystem::path> paths,
+           const std::shared_ptr<IncludeResolver> &resolver =
+               std::make_shared<IncludeResolver>(),
+           WorkerPool &pool = WorkerPool::shared(),
+           const Execution execution = Execution::Serial,
+           const Profile profile = Profile::Release) {
+  std::vector<Compiled> results(paths.size());
+  std::vector<WorkerPool::Task<void>> pending;
+  pending.reserve(paths.size());
+
+  for (size_t i = 0; i < paths.size(); i++) {
+    pending.push_back(
+        pool.submit([&result = results[i], &path = paths[i], &resolver,
+                     execution, profile] {
+          result.path = path;
+          result.output = compile(path, result.sink, VK_NULL_HANDLE, resolver,
+                                  execution, profile);
+        }));
+  }
+
+  for (auto &job : pending) {
+    pool.wait(job);
+  }
+
+  return results;
+}
+
+} // namespace ryuko::compilation
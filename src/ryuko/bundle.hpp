@@ -0,0 +1,555 @@
+#pragma once
+
+#include <ryuko/batch.hpp>
+#include <ryuko/compile.hpp>
+#include <ryuko/source.hpp>
+#include <ryuko/vfs.hpp>
+
+namespace ryuko {
+
+/*
+ *  Compiled pipelines packed offline, so a shipping build loads SPIR-V and
+ *  reflection without parsing a single shader. The file is mapped whatever
+ *  its size, and shader modules are created straight from the mapping.
+ *
+ *  Layout, little endian, offsets from the start of the bundle:
+ *    Header                  magic "RYKB", version, pipeline count
+ *    Entry[count]            name, per-stage SPIR-V and reflection ranges
+ *    names, code, tables     back to back, each aligned to 8 bytes
+ *
+ *  Reflection tables hold the pipeline configuration, vertex inputs,
+ *  uniforms, storage buffers and shader inputs, as length-prefixed fields.
+ */
+class Bundle final {
+public:
+  static constexpr std::array<char, 4> Magic{'R', 'Y', 'K', 'B'};
+  static constexpr uint32_t Version = 1;
+
+  struct Header {
+    std::array<char, 4> magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t reserved;
+  };
+
+  struct Range {
+    uint64_t offset;
+    uint64_t size;
+  };
+
+  struct Entry {
+    Range name;
+    Range vertex;
+    Range fragment;
+    Range reflection;
+  };
+
+  static_assert(sizeof(Header) == 16 && sizeof(Entry) == 64);
+
+  //  @note: fields are written and read in host order
+  static_assert(std::endian::native == std::endian::little,
+                "bundles are little endian");
+
+  //  @note: views into the bundle, valid as long as it is
+  struct Pipeline {
+    std::string_view name;
+    std::span<const uint32_t> vertex;
+    std::span<const uint32_t> fragment;
+    std::string_view reflection;
+
+  public:
+    [[nodiscard]] bool hasFragmentCode() const { return !fragment.empty(); }
+
+    [[nodiscard]] VkShaderModuleCreateInfo vertexCreateInfo() const {
+      return createInfo(vertex);
+    }
+
+    [[nodiscard]] VkShaderModuleCreateInfo fragmentCreateInfo() const {
+      return createInfo(fragment);
+    }
+
+  private:
+    [[nodiscard]] static VkShaderModuleCreateInfo
+    createInfo(const std::span<const uint32_t> code) {
+      VkShaderModuleCreateInfo info{};
+      info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+      info.pNext = nullptr;
+      info.codeSize = code.size_bytes();
+      info.pCode = code.data();
+
+      return info;
+    }
+  };
+
+private:
+  SourceFile file;
+  std::unordered_map<std::string_view, Pipeline> pipelines;
+
+public:
+  Bundle() = default;
+  Bundle(const Bundle &) = delete;
+  Bundle &operator=(const Bundle &) = delete;
+
+public:
+  [[nodiscard]] static std::unique_ptr<Bundle>
+  open(const std::filesystem::path &path) {
+    //  @note: bundles are replaced by renaming, never rewritten in place
+    auto source = SourceFile::open(path, SourceFile::Map::Always);
+    if (!source.has_value()) {
+      error("failed to open bundle {}", path.c_str());
+      return nullptr;
+    }
+
+    return load(std::move(source.value()));
+  }
+
+  [[nodiscard]] static std::unique_ptr<Bundle> load(SourceFile source) {
+    auto bundle = std::make_unique<Bundle>();
+    bundle->file = std::move(source);
+
+    if (!bundle->index()) {
+      return nullptr;
+    }
+
+    return bundle;
+  }
+
+  /*
+   *  Pipelines are named by their path relative to `root`, as find() looks
+   *  them up. Shaders that failed to compile are left out, also when only
+   *  their fragment stage did, rather than packed as vertex-only pipelines.
+   */
+  [[nodiscard]] static std::string
+  pack(const std::span<const compilation::Compiled> shaders,
+       const std::filesystem::path &root = {}) {
+    const auto align = [](const uint64_t offset) {
+      return (offset + 7) & ~uint64_t{7};
+    };
+
+    struct Packed {
+      std::string name;
+      std::span<const uint32_t> vertex;
+      std::span<const uint32_t> fragment;
+      std::string reflection;
+    };
+
+    std::vector<Packed> packed;
+    packed.reserve(shaders.size());
+
+    for (const auto &shader : shaders) {
+      if (!shader.succeeded()) {
+        continue;
+      }
+
+      const auto &spirv = shader.sink.spirv;
+      auto &entry = packed.emplace_back();
+      entry.name = SourceProvider::normalize(
+          root.empty() ? shader.path : shader.path.lexically_relative(root));
+      entry.vertex = spirv.vertexCode.value();
+      if (spirv.fragmentCode.has_value()) {
+        entry.fragment = spirv.fragmentCode.value();
+      }
+
+      entry.reflection = reflect(shader.sink);
+    }
+
+    uint64_t size = sizeof(Header) + packed.size() * sizeof(Entry);
+    std::vector<Entry> entries(packed.size());
+
+    const auto place = [&](Range &range, const uint64_t bytes) {
+      range.offset = align(size);
+      range.size = bytes;
+      size = range.offset + bytes;
+    };
+
+    for (size_t i = 0; i < packed.size(); i++) {
+      place(entries[i].name, packed[i].name.size());
+      place(entries[i].vertex, packed[i].vertex.size_bytes());
+      place(entries[i].fragment, packed[i].fragment.size_bytes());
+      place(entries[i].reflection, packed[i].reflection.size());
+    }
+
+    std::string blob(size, '\0');
+
+    const Header header{Magic, Version, static_cast<uint32_t>(packed.size()),
+                        0};
+    std::memcpy(blob.data(), &header, sizeof(header));
+    std::memcpy(blob.data() + sizeof(Header), entries.data(),
+                entries.size() * sizeof(Entry));
+
+    for (size_t i = 0; i < packed.size(); i++) {
+      const auto copy = [&blob](const Range &range, const void *data) {
+        if (range.size) {
+          std::memcpy(blob.data() + range.offset, data, range.size);
+        }
+      };
+
+      copy(entries[i].name, packed[i].name.data());
+      copy(entries[i].vertex, packed[i].vertex.data());
+      copy(entries[i].fragment, packed[i].fragment.data());
+      copy(entries[i].reflection, packed[i].reflection.data());
+    }
+
+    return blob;
+  }
+
+public:
+  [[nodiscard]] Optional<Pipeline> find(const std::string_view name) const {
+    const auto it = pipelines.find(name);
+    if (it == pipelines.end()) {
+      return {};
+    }
+
+    return it->second;
+  }
+
+  /*
+   *  Fills `sink` as compilation::compile() would for the shader: shader
+   *  modules created from the mapped SPIR-V, reflection decoded from the
+   *  tables.
+   */
+  bool load(const std::string_view name, compilation::Sink &sink,
+            const VkDevice device) const {
+    const auto pipeline = find(name);
+    if (!pipeline.has_value()) {
+      error("no pipeline {} in bundle", name);
+      return false;
+    }
+
+    if (!unreflect(pipeline->reflection, sink)) {
+      error("reflection of pipeline {} is corrupt", name);
+      return false;
+    }
+
+    sink.load(device, pipeline->vertex, pipeline->fragment, name);
+    if (!sink.hasVertexCode() ||
+        (pipeline->hasFragmentCode() && !sink.hasFragmentCode())) {
+      error("failed to create the shader modules of pipeline {}", name);
+      sink.unload(device);
+      return false;
+    }
+
+    return true;
+  }
+
+  [[nodiscard]] size_t size() const { return pipelines.size(); }
+
+  //  @note: false for a bundle loaded from memory
+  [[nodiscard]] bool isMapped() const { return file.isMapped(); }
+
+  [[nodiscard]] std::vector<std::string_view> names() const {
+    std::vector<std::string_view> result;
+    result.reserve(pipelines.size());
+
+    for (const auto &[name, pipeline] : pipelines) {
+      result.push_back(name);
+    }
+
+    std::ranges::sort(result);
+    return result;
+  }
+
+private:
+  bool index() {
+    const auto data = file.content();
+
+    //  @note: SPIR-V has to be 4-byte aligned for the driver, ranges are
+    //  aligned relative to the start
+    if (reinterpret_cast<uintptr_t>(data.data()) % alignof(uint32_t)) {
+      error("bundle is not aligned");
+      return false;
+    }
+
+    Header header{};
+    if (data.size() < sizeof(header)) {
+      error("bundle is truncated");
+      return false;
+    }
+
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (header.magic != Magic || header.version != Version) {
+      error("not a ryuko bundle, or version {} is not supported",
+            header.version);
+      return false;
+    }
+
+    if ((data.size() - sizeof(Header)) / sizeof(Entry) < header.count) {
+      error("bundle is truncated");
+      return false;
+    }
+
+    const auto within = [&](const Range &range) {
+      return range.offset <= data.size() &&
+             range.size <= data.size() - range.offset;
+    };
+
+    const auto code = [&](const Range &range) {
+      return std::span{
+          reinterpret_cast<const uint32_t *>(data.data() + range.offset),
+          range.size / sizeof(uint32_t)};
+    };
+
+    pipelines.reserve(header.count);
+    for (uint32_t i = 0; i < header.count; i++) {
+      Entry entry{};
+      std::memcpy(&entry, data.data() + sizeof(Header) + i * sizeof(Entry),
+                  sizeof(entry));
+
+      if (!within(entry.name) || !within(entry.vertex) ||
+          !within(entry.fragment) || !within(entry.reflection) ||
+          entry.vertex.offset % alignof(uint32_t) ||
+          entry.fragment.offset % alignof(uint32_t)) {
+        error("bundle entry {} is out of bounds", i);
+        return false;
+      }
+
+      Pipeline pipeline{};
+      pipeline.name = data.substr(entry.name.offset, entry.name.size);
+      pipeline.vertex = code(entry.vertex);
+      pipeline.fragment = code(entry.fragment);
+      pipeline.reflection =
+          data.substr(entry.reflection.offset, entry.reflection.size);
+
+      if (!pipelines.emplace(pipeline.name, pipeline).second) {
+        error("bundle has two pipelines named {}", pipeline.name);
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  static void put(std::string &out, const uint32_t value) {
+    out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+  }
+
+  static void put(std::string &out, const std::string_view text) {
+    put(out, static_cast<uint32_t>(text.size()));
+    out.append(text);
+  }
+
+  static void put(std::string &out, const Struct &description) {
+    put(out, description.name);
+    put(out, static_cast<uint32_t>(description.fields.size()));
+
+    for (const auto &field : description.fields) {
+      put(out, field.type);
+      put(out, field.name);
+      put(out, static_cast<uint32_t>(field.array));
+    }
+  }
+
+  static void put(std::string &out, const Uniform &uniform) {
+    put(out, uniform.value.struct_);
+    put(out, uniform.value.kind);
+    put(out, uniform.value.arrayLength);
+    put(out, static_cast<uint32_t>(uniform.value.array));
+    put(out, uniform.accessor);
+    put(out, uniform.set);
+    put(out, uniform.binding);
+  }
+
+  static void put(std::string &out, const StorageBuffer &buffer) {
+    put(out, buffer.description);
+    put(out, buffer.name);
+    put(out, buffer.set);
+    put(out, buffer.binding);
+    put(out, static_cast<uint32_t>(buffer.readonly));
+  }
+
+  [[nodiscard]] static std::string reflect(const compilation::Sink &sink) {
+    std::string out;
+
+    const auto &config = sink.config;
+    for (const uint32_t value : {
+             static_cast<uint32_t>(config.blend.value),
+             static_cast<uint32_t>(config.depthTest.value),
+             static_cast<uint32_t>(config.depthWrite.value),
+             static_cast<uint32_t>(config.depthOp.value),
+             static_cast<uint32_t>(config.polygon.value),
+             static_cast<uint32_t>(config.cull.value),
+             static_cast<uint32_t>(config.front_face.value),
+             static_cast<uint32_t>(config.topology.value),
+             static_cast<uint32_t>(config.multisampling.value),
+             static_cast<uint32_t>(config.colorAttachmentCount.count),
+             static_cast<uint32_t>(config.depthAttachment.enabled),
+         }) {
+      put(out, value);
+    }
+
+    put(out, static_cast<uint32_t>(sink.vertexInputs.size()));
+    for (const auto &varying : sink.vertexInputs) {
+      put(out, varying.name);
+      put(out, varying.type);
+      put(out, varying.precision);
+      put(out, static_cast<uint32_t>(varying.vertexInput) |
+                   static_cast<uint32_t>(varying.fragmentInput) << 1 |
+                   static_cast<uint32_t>(varying.vertexOutput) << 2 |
+                   static_cast<uint32_t>(varying.fragmentOutput) << 3);
+    }
+
+    put(out, static_cast<uint32_t>(sink.uniforms.size()));
+    for (const auto &uniform : sink.uniforms) {
+      put(out, uniform);
+    }
+
+    put(out, static_cast<uint32_t>(sink.storageBuffers.size()));
+    for (const auto &buffer : sink.storageBuffers) {
+      put(out, buffer);
+    }
+
+    put(out, static_cast<uint32_t>(sink.inputs.size()));
+    for (const auto &input : sink.inputs) {
+      put(out, input.kind);
+      if (input.kind == ShaderInput::Kind_Uniform) {
+        put(out, input.uniform);
+      } else {
+        put(out, input.storageBuffer);
+      }
+    }
+
+    return out;
+  }
+
+  //  @note: every read is bounds checked, a short table fails the whole load
+  struct Reader {
+    std::string_view data;
+    bool ok = true;
+
+  public:
+    uint32_t u32() {
+      uint32_t value = 0;
+      if (data.size() < sizeof(value)) {
+        ok = false;
+        return value;
+      }
+
+      std::memcpy(&value, data.data(), sizeof(value));
+      data.remove_prefix(sizeof(value));
+      return value;
+    }
+
+    std::string_view text() {
+      const auto size = u32();
+      if (data.size() < size) {
+        ok = false;
+        return {};
+      }
+
+      const auto value = data.substr(0, size);
+      data.remove_prefix(size);
+      return value;
+    }
+
+    //  @note: counts are checked against what is left, so a corrupt one
+    //  cannot make the caller reserve gigabytes
+    uint32_t count() {
+      const auto value = u32();
+      if (value > data.size()) {
+        ok = false;
+        return 0;
+      }
+
+      return value;
+    }
+
+    void read(Struct &description) {
+      description.name = text();
+
+      const auto fields = count();
+      description.fields.clear();
+      description.fields.reserve(fields);
+      for (uint32_t i = 0; i < fields && ok; i++) {
+        auto &field = description.fields.emplace_back();
+        field.type = text();
+        field.name = text();
+        field.array = u32() != 0;
+      }
+    }
+
+    void read(Uniform &uniform) {
+      read(uniform.value.struct_);
+      uniform.value.kind = u32();
+      uniform.value.arrayLength = u32();
+      uniform.value.array = u32() != 0;
+      uniform.accessor = text();
+      uniform.set = u32();
+      uniform.binding = u32();
+    }
+
+    void read(StorageBuffer &buffer) {
+      read(buffer.description);
+      buffer.name = text();
+      buffer.set = u32();
+      buffer.binding = u32();
+      buffer.readonly = u32() != 0;
+    }
+  };
+
+  [[nodiscard]] static bool unreflect(const std::string_view table,
+                                      compilation::Sink &sink) {
+    Reader reader{table};
+
+    auto &config = sink.config;
+    config.blend.value = static_cast<config::ColorBlend::Value>(reader.u32());
+    config.depthTest.value =
+        static_cast<config::DepthTest::Value>(reader.u32());
+    config.depthWrite.value =
+        static_cast<config::DepthWrite::Value>(reader.u32());
+    config.depthOp.value = static_cast<config::DepthOp::Value>(reader.u32());
+    config.polygon.value = static_cast<config::Polygon::Value>(reader.u32());
+    config.cull.value = static_cast<config::Cull::Value>(reader.u32());
+    config.front_face.value =
+        static_cast<config::FrontFace::Value>(reader.u32());
+    config.topology.value = static_cast<config::Topology::Value>(reader.u32());
+    config.multisampling.value =
+        static_cast<config::Multisampling::Value>(reader.u32());
+    config.colorAttachmentCount.count = static_cast<int>(reader.u32());
+    config.depthAttachment.enabled = reader.u32() != 0;
+
+    sink.vertexInputs.clear();
+    const auto varyings = reader.count();
+    for (uint32_t i = 0; i < varyings && reader.ok; i++) {
+      auto &varying = sink.vertexInputs.emplace_back();
+      varying.name = reader.text();
+      varying.type = reader.text();
+      varying.precision = reader.text();
+
+      const auto flags = reader.u32();
+      varying.vertexInput = flags & 1;
+      varying.fragmentInput = flags & 2;
+      varying.vertexOutput = flags & 4;
+      varying.fragmentOutput = flags & 8;
+    }
+
+    sink.uniforms.clear();
+    const auto uniforms = reader.count();
+    for (uint32_t i = 0; i < uniforms && reader.ok; i++) {
+      reader.read(sink.uniforms.emplace_back());
+    }
+
+    sink.storageBuffers.clear();
+    const auto buffers = reader.count();
+    for (uint32_t i = 0; i < buffers && reader.ok; i++) {
+      reader.read(sink.storageBuffers.emplace_back());
+    }
+
+    sink.inputs.clear();
+    const auto inputs = reader.count();
+    for (uint32_t i = 0; i < inputs && reader.ok; i++) {
+      if (reader.u32() == ShaderInput::Kind_Uniform) {
+        Uniform uniform{};
+        reader.read(uniform);
+        sink.inputs.emplace_back(ShaderInput::Kind_Uniform, uniform);
+      } else {
+        StorageBuffer buffer{};
+        reader.read(buffer);
+        sink.inputs.emplace_back(ShaderInput::Kind_StorageBuffer, buffer);
+      }
+    }
+
+    return reader.ok;
+  }
+};
+
+} // namespace ryuko
@@ -5,7 +5,9 @@
 #include <ryuko/core.hpp>
 #include <ryuko/emitter.hpp>
 #include <ryuko/includer.hpp>
+#include <ryuko/pool.hpp>
 #include <ryuko/process.hpp>
+#include <ryuko/spirv.hpp>
 
 namespace ryuko::compilation {
 
@@ -21,79 +23,335 @@ struct ShaderCompilationResult final {
 
 struct Output : Emitter::Output {
   int version;
+
+  //  every file the shader includes, directly or not, by identity
+  std::vector<std::string> includes;
 };
 
-static Optional<std::vector<uint32_t>>
-compile(const std::filesystem::path &inputFilePath, std::string_view source,
-        const ShaderStage stage) {
-  shaderc_shader_kind shaderStage;
-  switch (stage) {
-  case ShaderStage::Vertex:
-    shaderStage = shaderc_vertex_shader;
-    break;
-  case ShaderStage::Fragment:
-    shaderStage = shaderc_fragment_shader;
-    break;
-  default:
-    error("shader compilation failed: unsupported stage {}",
-          static_cast<int>(stage));
-    return {};
+/*
+ *  What a compilation is tuned for:
+ *    Fast      no optimization and full debug info, for iteration and hot
+ *              reload
+ *    Release   optimized for performance, the default
+ *    Size      optimized for size, debug instructions stripped from the
+ *              module, for shipping
+ */
+enum class Profile {
+  Fast,
+  Release,
+  Size,
+};
+
+static constexpr std::array<std::string_view, 3> ProfileNames{
+    "fast",
+    "release",
+    "size",
+};
+
+[[maybe_unused, nodiscard]] static constexpr std::string_view
+name(const Profile profile) {
+  return ProfileNames[static_cast<size_t>(profile)];
+}
+
+//  @note: empty for an unknown name
+[[maybe_unused, nodiscard]] static Optional<Profile>
+profile(const std::string_view name) {
+  for (size_t i = 0; i < ProfileNames.size(); i++) {
+    if (ProfileNames[i] == name) {
+      return static_cast<Profile>(i);
+    }
   }
 
-  const shaderc::Compiler compiler{};
-  shaderc::CompileOptions options{};
-  options.SetTargetEnvironment(shaderc_target_env_vulkan,
-                               shaderc_env_version_vulkan_1_3);
-  options.SetTargetSpirv(shaderc_spirv_version_1_6);
-  options.SetOptimizationLevel(shaderc_optimization_level_performance);
-  options.SetSourceLanguage(shaderc_source_language_glsl);
-  options.SetIncluder(std::make_unique<CustomIncluder>());
-
-  const auto preprocessedResult = compiler.PreprocessGlsl(
-      source.begin(), shaderStage, inputFilePath.c_str(), options);
-  if (preprocessedResult.GetCompilationStatus() !=
-      shaderc_compilation_status_success) {
-    error("shader preprocessing failed: {}",
-          preprocessedResult.GetErrorMessage());
-    return {};
+  return {};
+}
+
+//  @note: bump when stripDebugInfo() changes, its output is cached
+static constexpr uint64_t StripVersion = 1;
+
+/*
+ *  Removes debug instructions (source text, names, line info) from a module,
+ *  they are only read by tools and usually make up a good part of it.
+ */
+[[maybe_unused]]
+static void stripDebugInfo(std::vector<uint32_t> &code) {
+  constexpr size_t HeaderWords = 5;
+  if (code.size() <= HeaderWords) {
+    return;
+  }
+
+  const auto debug = [](const uint32_t opcode) {
+    switch (opcode) {
+    case 2:   //  OpSourceContinued
+    case 3:   //  OpSource
+    case 4:   //  OpSourceExtension
+    case 5:   //  OpName
+    case 6:   //  OpMemberName
+    case 7:   //  OpString
+    case 8:   //  OpLine
+    case 317: //  OpNoLine
+    case 330: //  OpModuleProcessed
+      return true;
+    default:
+      return false;
+    }
+  };
+
+  size_t read = HeaderWords;
+  size_t written = HeaderWords;
+  while (read < code.size()) {
+    const uint32_t words = code[read] >> 16;
+    if (words == 0 || read + words > code.size()) {
+      //  @note: malformed, keep the rest untouched
+      std::copy(code.begin() + read, code.end(), code.begin() + written);
+      written += code.size() - read;
+      break;
+    }
+
+    if (!debug(code[read] & 0xffff)) {
+      std::copy_n(code.begin() + read, words, code.begin() + written);
+      written += words;
+    }
+
+    read += words;
+  }
+
+  code.resize(written);
+}
+
+/*
+ *  A shaderc compiler and its options for one Profile, set up once and reused
+ *  for every stage compiled on the thread, instead of initialising both per
+ *  stage. Stages found in the SpirvCache skip shaderc entirely.
+ *
+ *  @note: not thread-safe, each thread uses its own through local()
+ */
+class CompilerContext final {
+  shaderc::Compiler compiler;
+  shaderc::CompileOptions options;
+  Profile selected;
+
+  //  @note: owned by options
+  CustomIncluder *includer;
+
+  //  @note: nullptr to always compile
+  SpirvCache *cache;
+
+  //  everything set on options and the toolchain, part of every cache key
+  uint64_t fingerprint;
+
+public:
+  explicit CompilerContext(const Profile profile = Profile::Release,
+                           SpirvCache *cache = &SpirvCache::shared())
+      : selected(profile), cache(cache) {
+    constexpr auto environment = shaderc_target_env_vulkan;
+    constexpr auto environmentVersion = shaderc_env_version_vulkan_1_3;
+    constexpr auto spirvVersion = shaderc_spirv_version_1_6;
+
+    auto optimizationLevel = shaderc_optimization_level_performance;
+    if (profile == Profile::Fast) {
+      optimizationLevel = shaderc_optimization_level_zero;
+      options.SetGenerateDebugInfo();
+    } else if (profile == Profile::Size) {
+      optimizationLevel = shaderc_optimization_level_size;
+    }
+
+    options.SetTargetEnvironment(environment, environmentVersion);
+    options.SetTargetSpirv(spirvVersion);
+    options.SetOptimizationLevel(optimizationLevel);
+    options.SetSourceLanguage(shaderc_source_language_glsl);
+
+    //  @note: changes with the shaderc build, so SPIR-V an older compiler
+    //  cached is not reused after an upgrade
+    unsigned int shadercVersion = 0;
+    unsigned int shadercRevision = 0;
+    shaderc_get_spv_version(&shadercVersion, &shadercRevision);
+
+    fingerprint = Digest{}
+                      .add(shadercVersion)
+                      .add(shadercRevision)
+                      .add(StripVersion)
+                      .add(static_cast<uint64_t>(profile))
+                      .add(environment)
+                      .add(environmentVersion)
+                      .add(spirvVersion)
+                      .add(optimizationLevel)
+                      .value();
+
+    auto customIncluder = std::make_unique<CustomIncluder>(nullptr);
+    includer = customIncluder.get();
+    options.SetIncluder(std::move(customIncluder));
+  }
+
+  CompilerContext(const CompilerContext &) = delete;
+  CompilerContext &operator=(const CompilerContext &) = delete;
+
+public:
+  //  @note: one per profile, made on first use
+  [[nodiscard]] static CompilerContext &
+  local(const Profile profile = Profile::Release) {
+    thread_local std::array<std::unique_ptr<CompilerContext>,
+                            ProfileNames.size()>
+        contexts;
+
+    auto &context = contexts[static_cast<size_t>(profile)];
+    if (!context) {
+      context = std::make_unique<CompilerContext>(profile);
+    }
+
+    return *context;
+  }
+
+  [[nodiscard]] Profile profile() const { return selected; }
+
+  /*
+   *  Compiles in a single pass, shaderc preprocesses as part of it. The
+   *  preprocessed source is only produced, by running the preprocessor
+   *  again, for the debug dump when compilation fails.
+   */
+  [[nodiscard]] Optional<std::vector<uint32_t>>
+  compile(const std::filesystem::path &inputFilePath,
+          const std::string_view source, const ShaderStage stage,
+          const std::shared_ptr<IncludeResolver> &resolver) {
+    const auto shaderStage = kind(stage);
+    if (!shaderStage.has_value()) {
+      error("shader compilation failed: unsupported stage {}",
+            static_cast<int>(stage));
+      return {};
+    }
+
+    Optional<uint64_t> key{};
+    if (cache && cache->enabled()) {
+      key = SpirvCache::key(source, inputFilePath,
+                            Digest{fingerprint}.add(*shaderStage).value(),
+                            resolver.get());
+
+      if (auto cached = cache->find(*key); cached.has_value()) {
+        return cached;
+      }
+    }
+
+    includer->bind(resolver);
+    const auto compilationResult =
+        compiler.CompileGlslToSpv(source.data(), source.size(), *shaderStage,
+                                  inputFilePath.c_str(), options);
+
+    Optional<std::vector<uint32_t>> result{};
+    if (compilationResult.GetCompilationStatus() ==
+        shaderc_compilation_status_success) {
+      result.emplace(compilationResult.begin(), compilationResult.end());
+
+      if (selected == Profile::Size) {
+        stripDebugInfo(result.value());
+      }
+
+      if (key.has_value()) {
+        cache->store(*key, result.value());
+      }
+    } else {
+      //  @note: the includer has to hand every file out again
+      includer->bind(resolver);
+      dump(inputFilePath, source, *shaderStage);
+
+      error("[gfx] shader compilation failed: {}",
+            compilationResult.GetErrorMessage());
+    }
+
+    //  @note: don't keep the session's files alive until the next compile
+    includer->bind(nullptr);
+
+    return result;
+  }
+
+private:
+  [[nodiscard]] static Optional<shaderc_shader_kind>
+  kind(const ShaderStage stage) {
+    switch (stage) {
+    case ShaderStage::Vertex:
+      return shaderc_vertex_shader;
+    case ShaderStage::Fragment:
+      return shaderc_fragment_shader;
+    default:
+      return {};
+    }
   }
 
-  const auto compilationResult = compiler.CompileGlslToSpv(
-      preprocessedResult.begin(),
-      preprocessedResult.end() - preprocessedResult.begin(), shaderStage,
-      inputFilePath.c_str(), options);
-  if (compilationResult.GetCompilationStatus() !=
-      shaderc_compilation_status_success) {
+  void dump(const std::filesystem::path &inputFilePath,
+            const std::string_view source,
+            const shaderc_shader_kind shaderStage) const {
+    const auto preprocessedResult =
+        compiler.PreprocessGlsl(source.data(), source.size(), shaderStage,
+                                inputFilePath.c_str(), options);
+    if (preprocessedResult.GetCompilationStatus() !=
+        shaderc_compilation_status_success) {
+      error("shader preprocessing failed: {}",
+            preprocessedResult.GetErrorMessage());
+      return;
+    }
+
     std::string preprocessedOutput{preprocessedResult.begin(),
                                    preprocessedResult.end()};
     debug("[gfx] preprocessed shader source:\n{}", preprocessedOutput);
-
-    error("[gfx] shader compilation failed: {}",
-          compilationResult.GetErrorMessage());
-    return {};
   }
+};
 
-  return {std::vector(compilationResult.begin(), compilationResult.end())};
+static Optional<std::vector<uint32_t>>
+compile(const std::filesystem::path &inputFilePath, std::string_view source,
+        const ShaderStage stage,
+        const std::shared_ptr<IncludeResolver> &resolver,
+        CompilerContext &compiler = CompilerContext::local()) {
+  return compiler.compile(inputFilePath, source, stage, resolver);
 }
 
-static ShaderCompilationResult compile(const std::filesystem::path &path,
-                                       const Emitter::Output &code) {
+/*
+ *  @note: pass the resolver the shader was parsed with, so its includes are
+ *  served from memory rather than read again. With Execution::Parallel the
+ *  fragment stage is compiled on the shared WorkerPool, with that thread's
+ *  CompilerContext for the same profile.
+ */
+static ShaderCompilationResult
+compile(const std::filesystem::path &path, const Emitter::Output &code,
+        const std::shared_ptr<IncludeResolver> &resolver =
+            std::make_shared<IncludeResolver>(),
+        const Execution execution = Execution::Serial,
+        CompilerContext &compiler = CompilerContext::local()) {
   ShaderCompilationResult result{};
 
+  const bool hasFragment = code.fragment.has_value() && !code.fragment->empty();
+
+  WorkerPool::Task<Optional<std::vector<uint32_t>>> pendingFragment;
+  if (hasFragment && execution == Execution::Parallel) {
+    pendingFragment = WorkerPool::shared().submit(
+        [&path, &code, &resolver, profile = compiler.profile()] {
+          return compile(path, code.fragment.value(), ShaderStage::Fragment,
+                         resolver, CompilerContext::local(profile));
+        });
+  }
+
   if (code.vertex.empty()) {
     error("no vertex shader?");
   } else {
-    result.vertexCode = compile(path, code.vertex, ShaderStage::Vertex);
+    result.vertexCode =
+        compile(path, code.vertex, ShaderStage::Vertex, resolver, compiler);
   }
 
-  if (code.fragment.has_value() && !code.fragment->empty()) {
-    result.fragmentCode =
-        compile(path, code.fragment.value(), ShaderStage::Fragment);
+  if (pendingFragment.valid()) {
+    result.fragmentCode = WorkerPool::shared().wait(pendingFragment);
+  } else if (hasFragment) {
+    result.fragmentCode = compile(path, code.fragment.value(),
+                                  ShaderStage::Fragment, resolver, compiler);
   }
 
   return result;
 }
 
+//  how a Sink's write() compiles the code it is given
+struct WriteOptions {
+  //  the files the shader was parsed from, to resolve includes against
+  std::shared_ptr<IncludeResolver> resolver;
+  Execution execution = Execution::Serial;
+  Profile profile = Profile::Release;
+};
+
 struct Sink {
   PipelineConfiguration config;
   std::vector<Varying> vertexInputs;
@@ -111,15 +369,37 @@ public:
   }
   [[nodiscard]] bool hasVertexCode() const { return vertex != VK_NULL_HANDLE; }
 
+  //  @note: whether write() produced every stage it was given
+  [[nodiscard]] virtual bool succeeded() const {
+    return hasVertexCode() && (!expectsFragment || hasFragmentCode());
+  }
+
   void load(const VkDevice device, const ShaderCompilationResult &result,
             const std::filesystem::path &path) {
+    std::span<const uint32_t> vertexCode{};
+    if (result.vertexCode.has_value()) {
+      vertexCode = result.vertexCode.value();
+    }
+
+    std::span<const uint32_t> fragmentCode{};
+    if (result.fragmentCode.has_value()) {
+      fragmentCode = result.fragmentCode.value();
+    }
+
+    load(device, vertexCode, fragmentCode, path);
+  }
+
+  //  @note: a stage without code gets no module
+  void load(const VkDevice device, const std::span<const uint32_t> vertexCode,
+            const std::span<const uint32_t> fragmentCode,
+            const std::filesystem::path &path) {
     VkShaderModuleCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
     createInfo.pNext = nullptr;
 
-    if (result.vertexCode.has_value()) {
-      createInfo.codeSize = result.vertexCode.value().size() * sizeof(uint32_t);
-      createInfo.pCode = result.vertexCode.value().data();
+    if (!vertexCode.empty()) {
+      createInfo.codeSize = vertexCode.size_bytes();
+      createInfo.pCode = vertexCode.data();
 
       if (vkCreateShaderModule(device, &createInfo, nullptr, &vertex) !=
           VK_SUCCESS) {
@@ -130,10 +410,9 @@ public:
       vertex = VK_NULL_HANDLE;
     }
 
-    if (result.fragmentCode.has_value()) {
-      createInfo.codeSize =
-          result.fragmentCode.value().size() * sizeof(uint32_t);
-      createInfo.pCode = result.fragmentCode.value().data();
+    if (!fragmentCode.empty()) {
+      createInfo.codeSize = fragmentCode.size_bytes();
+      createInfo.pCode = fragmentCode.data();
 
       if (vkCreateShaderModule(device, &createInfo, nullptr, &fragment) !=
           VK_SUCCESS) {
@@ -158,8 +437,36 @@ public:
     fragment = VK_NULL_HANDLE;
   }
 
+  /*
+   *  Compiles the emitted code and fills the sink. Override this one; the
+   *  default only forwards to the overload sinks were written against before
+   *  it took WriteOptions.
+   */
   virtual void write(const std::filesystem::path &basePath,
-                     const Emitter::Output &code, VkDevice device) = 0;
+                     const Emitter::Output &code, VkDevice device,
+                     [[maybe_unused]] const WriteOptions &options) {
+    write(basePath, code, device);
+  }
+
+  /*
+   *  @deprecated: override the overload taking WriteOptions instead. Sinks
+   *  that only override this one keep working, but compile without the
+   *  session's resolver, execution and profile.
+   */
+  virtual void write(const std::filesystem::path &basePath,
+                     [[maybe_unused]] const Emitter::Output &code,
+                     [[maybe_unused]] VkDevice device) {
+    error("sink for {} overrides no write()", basePath.c_str());
+  }
+
+protected:
+  //  whether the code last written has a fragment stage to compile
+  bool expectsFragment = false;
+
+  //  @note: call from write(), so succeeded() knows which stages to require
+  void expect(const Emitter::Output &code) {
+    expectsFragment = code.fragment.has_value() && !code.fragment->empty();
+  }
 };
 
 struct DefaultSink final : Sink {
@@ -167,10 +474,13 @@ struct DefaultSink final : Sink {
 
 public:
   void write(const std::filesystem::path &path, const Emitter::Output &code,
-             const VkDevice device) override {
+             const VkDevice device, const WriteOptions &options) override {
     this->path = path;
+    expect(code);
 
-    const auto result = compile(path, code);
+    const auto result =
+        compile(path, code, options.resolver, options.execution,
+                CompilerContext::local(options.profile));
     load(device, result, path);
   }
 };
@@ -182,58 +492,59 @@ struct MemorySink final : Sink {
 
 public:
   void write(const std::filesystem::path &path, const Emitter::Output &code,
-             const VkDevice device) override {
+             const VkDevice device, const WriteOptions &options) override {
     this->path = path;
+    expect(code);
     this->vertexCode = code.vertex;
 
     if (code.fragment.has_value()) {
       this->fragmentCode = code.fragment.value();
     }
 
-    const auto result = compile(path, code);
+    const auto result =
+        compile(path, code, options.resolver, options.execution,
+                CompilerContext::local(options.profile));
     load(device, result, path);
   }
 };
 
+/*
+ *  Shader source from memory, e.g. generated by a tool, `path` names it in
+ *  messages and outputs and anchors its relative includes.
+ */
 [[maybe_unused]]
-static Optional<Output> compile(const std::filesystem::path &path, Sink &sink,
-                                const VkDevice device) {
-  auto maybeProcessedOutput = process(path);
+static Optional<Output>
+compile(const std::string_view source, const std::filesystem::path &path,
+        Sink &sink, const VkDevice device,
+        const std::shared_ptr<IncludeResolver> &resolver =
+            std::make_shared<IncludeResolver>(),
+        const Execution execution = Execution::Serial,
+        const Profile profile = Profile::Release,
+        const Cancellation *cancellation = nullptr) {
+  //  @note: everything parsed for this shader is released in one go on return
+  std::pmr::monotonic_buffer_resource arena{ArenaInitialSize};
+
+  auto maybeProcessedOutput =
+      process(source, path, &arena, resolver, execution, cancellation);
   if (!maybeProcessedOutput.has_value()) {
     return {};
   }
 
+  if (cancelled(cancellation)) {
+    debug("cancelled after emitting: {}", path.c_str());
+    return {};
+  }
+
   auto &context = maybeProcessedOutput.value().context;
   const auto &emitterOutput = maybeProcessedOutput.value().output;
 
-  sink.write(path, emitterOutput, device);
-
-  sink.storageBuffers = context.storageBuffers;
-  sink.inputs = context.inputs;
-  sink.uniforms = context.uniforms;
-  sink.config = context.config;
-
-  //  @temp(v2f): generate vertex input struct
-  {
-    std::vector<Varying> vertexInputs;
-    std::vector<Varying> varyings;
-    std::vector<Varying> fragmentOutputs;
-
-    for (auto &varying : context.varyings) {
-      if (varying.vertexInput) {
-        vertexInputs.push_back(varying);
-      } else if (varying.fragmentOutput) {
-        fragmentOutputs.push_back(varying);
-      } else {
-        varyings.push_back(varying);
-      }
-    }
+  sink.write(path, emitterOutput, device, {resolver, execution, profile});
 
-    sink.vertexInputs = vertexInputs;
-  }
+  auto includes = reflect(context, sink);
 
   Output o{};
   o.version = context.version;
+  o.includes = std::move(includes);
 
   //  @fixme: what is this used for?
   o.fragment = path.parent_path() / fmt::format("{}.frag", path.stem().c_str());
@@ -242,4 +553,27 @@ static Optional<Output> compile(const std::filesystem::path &path, Sink &sink,
   return o;
 }
 
+/*
+ *  @note: pass a resolver to read sources through another SourceProvider or
+ *  with include search paths, or to share loaded files between shaders
+ */
+[[maybe_unused]]
+static Optional<Output>
+compile(const std::filesystem::path &path, Sink &sink, const VkDevice device,
+        const std::shared_ptr<IncludeResolver> &resolver =
+            std::make_shared<IncludeResolver>(),
+        const Execution execution = Execution::Serial,
+        const Profile profile = Profile::Release,
+        const Cancellation *cancellation = nullptr) {
+  const auto *file = resolver->load(path);
+  if (!file) {
+    error("failed to open file {}", path.c_str());
+
+    return {};
+  }
+
+  return compile(file->content(), path, sink, device, resolver, execution,
+                 profile, cancellation);
+}
+
 } // namespace ryuko::compilation
@@ -2,10 +2,20 @@
 
 #include <ryuko/pch.hpp>
 
+#include <ryuko/ast.hpp>
+
 namespace ryuko {
 
 template <typename T> using Optional = std::optional<T>;
 
+/*
+ *  Everything a Context owns is allocated through this, so a whole
+ *  compilation can live in one arena and be released in a single go.
+ *  Copies made with the regular copy constructors fall back to the default
+ *  resource, which is how results escape the arena (e.g. into a Sink).
+ */
+using Allocator = std::pmr::polymorphic_allocator<>;
+
 static constexpr std::string EmptyString = {};
 static constexpr auto VertFunctionName = "vert";
 static constexpr auto FragFunctionName = "frag";
@@ -27,23 +37,71 @@ static void error(fmt::format_string<T...> fmt, T &&...args) {
 }
 
 struct Function {
+  using allocator_type = Allocator;
+
   struct Argument {
-    std::string type;
-    std::string name;
+    using allocator_type = Allocator;
+
+  public:
+    std::pmr::string type;
+    std::pmr::string name;
     bool array = false;
+
+  public:
+    Argument() = default;
+
+    explicit Argument(const allocator_type &allocator)
+        : type(allocator), name(allocator) {}
+
+    Argument(const std::string_view type, const std::string_view name,
+             const allocator_type &allocator = {})
+        : type(type, allocator), name(name, allocator) {}
+
+    Argument(const Argument &other, const allocator_type &allocator)
+        : type(other.type, allocator), name(other.name, allocator),
+          array(other.array) {}
+
+    Argument(Argument &&other, const allocator_type &allocator)
+        : type(std::move(other.type), allocator),
+          name(std::move(other.name), allocator), array(other.array) {}
   };
 
 public:
-  std::string returnType;
-  std::string name;
-  std::string body;
-  std::vector<Argument> args;
+  std::pmr::string returnType;
+  std::pmr::string name;
+  std::pmr::string body;
+  std::pmr::vector<Argument> args;
+
+  //  @note: built from body, rebuild it whenever body is rewritten
+  Ast ast;
+
+public:
+  Function() = default;
+
+  explicit Function(const allocator_type &allocator)
+      : returnType(allocator), name(allocator), body(allocator),
+        args(allocator), ast(allocator) {}
+
+  Function(const Function &other, const allocator_type &allocator)
+      : returnType(other.returnType, allocator), name(other.name, allocator),
+        body(other.body, allocator), args(other.args, allocator),
+        ast(other.ast, allocator) {}
+
+  Function(Function &&other, const allocator_type &allocator)
+      : returnType(std::move(other.returnType), allocator),
+        name(std::move(other.name), allocator),
+        body(std::move(other.body), allocator),
+        args(std::move(other.args), allocator),
+        ast(std::move(other.ast), allocator) {}
 };
 
 struct Varying {
-  std::string name;
-  std::string type;
-  std::string precision;
+  using allocator_type = Allocator;
+
+public:
+  std::pmr::string name;
+  std::pmr::string type;
+  std::pmr::string precision;
 
   //  @temp(v2f): mark inputs/outputs
   bool vertexInput = false;
@@ -51,17 +109,59 @@ struct Varying {
 
   bool vertexOutput = false;
   bool fragmentOutput = false;
+
+public:
+  Varying() = default;
+
+  explicit Varying(const allocator_type &allocator)
+      : name(allocator), type(allocator), precision(allocator) {}
+
+  Varying(const std::string_view name, const std::string_view type,
+          const std::string_view precision,
+          const allocator_type &allocator = {})
+      : name(name, allocator), type(type, allocator),
+        precision(precision, allocator) {}
+
+  Varying(const Varying &other, const allocator_type &allocator)
+      : name(other.name, allocator), type(other.type, allocator),
+        precision(other.precision, allocator), vertexInput(other.vertexInput),
+        fragmentInput(other.fragmentInput), vertexOutput(other.vertexOutput),
+        fragmentOutput(other.fragmentOutput) {}
+
+  Varying(Varying &&other, const allocator_type &allocator)
+      : name(std::move(other.name), allocator),
+        type(std::move(other.type), allocator),
+        precision(std::move(other.precision), allocator),
+        vertexInput(other.vertexInput), fragmentInput(other.fragmentInput),
+        vertexOutput(other.vertexOutput),
+        fragmentOutput(other.fragmentOutput) {}
 };
 
 struct Struct {
   using Field = Function::Argument;
+  using allocator_type = Allocator;
 
 public:
-  std::string name;
-  std::vector<Field> fields;
+  std::pmr::string name;
+  std::pmr::vector<Field> fields;
+
+public:
+  Struct() = default;
+
+  explicit Struct(const allocator_type &allocator)
+      : name(allocator), fields(allocator) {}
+
+  Struct(const Struct &other, const allocator_type &allocator)
+      : name(other.name, allocator), fields(other.fields, allocator) {}
+
+  Struct(Struct &&other, const allocator_type &allocator)
+      : name(std::move(other.name), allocator),
+        fields(std::move(other.fields), allocator) {}
 };
 
 struct UniformValue {
+  using allocator_type = Allocator;
+
   constexpr static uint32_t Kind_Unknown = 0;
   constexpr static uint32_t Kind_Struct = 1;
   constexpr static uint32_t Kind_PushConstants = 2;
@@ -71,44 +171,96 @@ struct UniformValue {
 public:
   Struct struct_;
   uint32_t kind = Kind_Unknown;
-  uint32_t arrayLength;
+  uint32_t arrayLength = 0;
 
   //  @todo: use a bit of kind to store this instead
   bool array = false;
+
+public:
+  UniformValue() = default;
+
+  explicit UniformValue(const allocator_type &allocator)
+      : struct_(allocator) {}
+
+  UniformValue(const UniformValue &other, const allocator_type &allocator)
+      : struct_(other.struct_, allocator), kind(other.kind),
+        arrayLength(other.arrayLength), array(other.array) {}
 };
 
 struct Uniform {
   using Field = Function::Argument;
+  using allocator_type = Allocator;
 
 public:
   UniformValue value;
-  std::string accessor;
+  std::pmr::string accessor;
   uint32_t set;
   uint32_t binding;
+
+public:
+  Uniform() = default;
+
+  explicit Uniform(const allocator_type &allocator)
+      : value(allocator), accessor(allocator) {}
+
+  Uniform(const Uniform &other, const allocator_type &allocator)
+      : value(other.value, allocator), accessor(other.accessor, allocator),
+        set(other.set), binding(other.binding) {}
 };
 
-struct PushConstantsLayout : Struct {};
+struct PushConstantsLayout : Struct {
+  using Struct::Struct;
+};
 
 struct BufferLayout {
-  std::string typeName;
-  std::string name;
+  using allocator_type = Allocator;
+
+public:
+  std::pmr::string typeName;
+  std::pmr::string name;
 
   //  @fixme: standard has limited number of values
   //  @fixme: change standard's type to bitfield
   //  @fixme: readonly should be part of standard
   uint32_t standard;
   bool readonly;
+
+public:
+  BufferLayout() = default;
+
+  explicit BufferLayout(const allocator_type &allocator)
+      : typeName(allocator), name(allocator), standard(0), readonly(false) {}
+
+  BufferLayout(const BufferLayout &other, const allocator_type &allocator)
+      : typeName(other.typeName, allocator), name(other.name, allocator),
+        standard(other.standard), readonly(other.readonly) {}
 };
 
 struct StorageBuffer {
+  using allocator_type = Allocator;
+
+public:
   Struct description;
-  std::string name;
+  std::pmr::string name;
   uint32_t set;
   uint32_t binding;
   bool readonly;
+
+public:
+  StorageBuffer() = default;
+
+  explicit StorageBuffer(const allocator_type &allocator)
+      : description(allocator), name(allocator), set(0), binding(0),
+        readonly(false) {}
+
+  StorageBuffer(const StorageBuffer &other, const allocator_type &allocator)
+      : description(other.description, allocator), name(other.name, allocator),
+        set(other.set), binding(other.binding), readonly(other.readonly) {}
 };
 
 struct ShaderInput {
+  using allocator_type = Allocator;
+
   static constexpr uint32_t Kind_Uniform = 0;
   static constexpr uint32_t Kind_StorageBuffer = 1;
 
@@ -118,11 +270,13 @@ public:
   uint32_t kind;
 
 public:
-  ShaderInput(const uint32_t kind, const Uniform &uniform)
-      : uniform(uniform), kind(kind) {}
+  ShaderInput(const uint32_t kind, const Uniform &uniform,
+              const allocator_type &allocator = {})
+      : uniform(uniform, allocator), storageBuffer(allocator), kind(kind) {}
 
-  ShaderInput(const uint32_t kind, const StorageBuffer &buffer)
-      : storageBuffer(buffer), kind(kind) {}
+  ShaderInput(const uint32_t kind, const StorageBuffer &buffer,
+              const allocator_type &allocator = {})
+      : uniform(allocator), storageBuffer(buffer, allocator), kind(kind) {}
 
   ~ShaderInput() {}
 
@@ -136,6 +290,17 @@ public:
     }
   }
 
+  ShaderInput(const ShaderInput &other, const allocator_type &allocator)
+      : uniform(allocator), storageBuffer(allocator) {
+    this->kind = other.kind;
+
+    if (this->kind == Kind_Uniform) {
+      this->uniform = other.uniform;
+    } else if (this->kind == Kind_StorageBuffer) {
+      this->storageBuffer = other.storageBuffer;
+    }
+  }
+
   ShaderInput &operator=(const ShaderInput &other) {
     this->kind = other.kind;
 
@@ -326,7 +491,12 @@ struct ColorAttachmentCount {
   int count;
 
   static Optional<int> parse(const std::string_view str) {
-    return atoi(str.begin() + 1); // NOLINT(*-err33-c)
+    int count = 0;
+    if (!str.empty()) {
+      std::from_chars(str.data() + 1, str.data() + str.size(), count);
+    }
+
+    return count;
   }
 };
 
@@ -351,14 +521,6 @@ using ConfigValue =
                  FrontFace, Topology, Multisampling, ColorAttachmentCount,
                  DepthAttachment>;
 
-static const std::unordered_map<std::string_view, int> variableTypeMap = {
-    {"color_blend", 0},      {"depth_test", 1},
-    {"depth_write", 2},      {"depth_op", 3},
-    {"polygon", 4},          {"cull", 5},
-    {"front_face", 6},       {"topology", 7},
-    {"multisampling", 8},    {"color_attachment_count", 9},
-    {"depth_attachment", 10}};
-
 } // namespace config
 
 struct PipelineConfiguration {
@@ -375,18 +537,199 @@ struct PipelineConfiguration {
   config::DepthAttachment depthAttachment;
 };
 
+/*
+ *  Which functions each function calls, by index into Context::scope.
+ *  Edges come from the call nodes of every body, so `fresnel` is only a
+ *  callee of bodies that actually call `fresnel`, and overloads sharing a
+ *  name are all reachable. Callees are stored in declaration order, adjacency
+ *  lists packed back to back in a single vector.
+ */
+struct CallGraph {
+  using allocator_type = Allocator;
+
+public:
+  //  @note: callees of i are edges[offsets[i], offsets[i + 1])
+  std::pmr::vector<uint32_t> offsets;
+  std::pmr::vector<uint32_t> edges;
+
+public:
+  CallGraph() = default;
+
+  explicit CallGraph(const allocator_type &allocator)
+      : offsets(allocator), edges(allocator) {}
+
+  CallGraph(const CallGraph &other, const allocator_type &allocator)
+      : offsets(other.offsets, allocator), edges(other.edges, allocator) {}
+
+  CallGraph(CallGraph &&other, const allocator_type &allocator)
+      : offsets(std::move(other.offsets), allocator),
+        edges(std::move(other.edges), allocator) {}
+
+public:
+  static CallGraph build(const std::pmr::vector<const Function *> &functions,
+                         const allocator_type &allocator) {
+    CallGraph graph{allocator};
+    graph.offsets.reserve(functions.size() + 1);
+    graph.offsets.push_back(0);
+
+    std::pmr::unordered_multimap<std::string_view, uint32_t> byName{allocator};
+    byName.reserve(functions.size());
+    for (uint32_t i = 0; i < functions.size(); i++) {
+      byName.emplace(functions[i]->name, i);
+    }
+
+    for (uint32_t caller = 0; caller < functions.size(); caller++) {
+      const auto *function = functions[caller];
+      const auto first = graph.edges.size();
+
+      for (const auto &node : function->ast.nodes) {
+        if (node.kind != Ast::Kind::Call || node.tokenLength == 0) {
+          continue;
+        }
+
+        //  @note: a function may call its own overloads, but not itself
+        const auto [begin, end] =
+            byName.equal_range(Ast::text(node, function->body));
+        for (auto it = begin; it != end; ++it) {
+          if (it->second != caller) {
+            graph.edges.push_back(it->second);
+          }
+        }
+      }
+
+      const auto callees = graph.edges.begin() + static_cast<ptrdiff_t>(first);
+      std::sort(callees, graph.edges.end());
+      graph.edges.erase(std::unique(callees, graph.edges.end()),
+                        graph.edges.end());
+
+      graph.offsets.push_back(static_cast<uint32_t>(graph.edges.size()));
+    }
+
+    return graph;
+  }
+
+  [[nodiscard]] std::span<const uint32_t>
+  callees(const uint32_t function) const {
+    if (function + 1 >= offsets.size()) {
+      return {};
+    }
+
+    return std::span{edges}.subspan(offsets[function],
+                                    offsets[function + 1] - offsets[function]);
+  }
+};
+
 struct Context {
+  using allocator_type = Allocator;
+
+public:
   PushConstantsLayout pushConstantsLayout;
   PipelineConfiguration config;
-  std::vector<std::string> directives;
-  std::vector<Function> functions;
-  std::vector<Varying> varyings;
-  std::vector<std::string> inlinedFragmentCode;
-  std::vector<Uniform> uniforms;
-  std::vector<BufferLayout> bufferLayouts;
-  std::vector<StorageBuffer> storageBuffers;
-  std::vector<ShaderInput> inputs;
+  std::pmr::vector<std::pmr::string> directives;
+  std::pmr::vector<Function> functions;
+  std::pmr::vector<Varying> varyings;
+  std::pmr::vector<std::pmr::string> inlinedFragmentCode;
+  std::pmr::vector<Uniform> uniforms;
+  std::pmr::vector<BufferLayout> bufferLayouts;
+  std::pmr::vector<StorageBuffer> storageBuffers;
+  std::pmr::vector<ShaderInput> inputs;
   int version;
+
+  //  file this was parsed from, canonical for includes
+  std::pmr::string path;
+
+  //  of the content parsed, set for includes only
+  size_t hash = 0;
+
+  //  @note: parsed once and shared through the include cache, never copied.
+  //  Each file links its direct includes, together they form the include DAG
+  std::pmr::vector<std::shared_ptr<const Context>> includes;
+
+  //  every function visible from this file: those of the includes, then its
+  //  own, filled in by link() once parsing is done
+  std::pmr::vector<const Function *> scope;
+  CallGraph calls;
+
+public:
+  explicit Context(const allocator_type &allocator = {})
+      : pushConstantsLayout(allocator), config(), directives(allocator),
+        functions(allocator), varyings(allocator),
+        inlinedFragmentCode(allocator), uniforms(allocator),
+        bufferLayouts(allocator), storageBuffers(allocator), inputs(allocator),
+        version(0), path(allocator), includes(allocator), scope(allocator),
+        calls(allocator) {}
+
+  //  @note: scope points into functions, moving keeps it valid, copying not
+  Context(const Context &) = delete;
+  Context(Context &&) = default;
+  Context &operator=(const Context &) = delete;
+  Context &operator=(Context &&) = delete;
+
+  [[nodiscard]] allocator_type get_allocator() const {
+    return functions.get_allocator();
+  }
+
+  /*
+   *  Calls visitor with every context visible from this one, each include
+   *  once however many paths lead to it, includes before their includers.
+   */
+  template <typename Visitor> void visit(Visitor &&visitor) const {
+    std::pmr::unordered_set<const Context *> visited{get_allocator()};
+    visit(visitor, visited);
+  }
+
+  [[nodiscard]] bool owns(const Function *function) const {
+    return function >= functions.data() &&
+           function < functions.data() + functions.size();
+  }
+
+  /*
+   *  Makes what the includes declare visible to this file, once per file
+   *  however many paths lead to it: fills in scope and the call graph, and
+   *  puts copies of the included varyings, whose direction is decided per
+   *  program, in front of its own.
+   *
+   *  @note: only for the file being compiled, includes are left unlinked
+   */
+  void link() {
+    std::pmr::vector<Varying> visibleVaryings{get_allocator()};
+
+    scope.clear();
+    visit([&](const Context &context) {
+      for (const auto &function : context.functions) {
+        scope.push_back(&function);
+      }
+
+      if (&context != this) {
+        visibleVaryings.insert(visibleVaryings.end(), context.varyings.begin(),
+                               context.varyings.end());
+      }
+    });
+
+    if (!visibleVaryings.empty()) {
+      visibleVaryings.insert(visibleVaryings.end(),
+                             std::make_move_iterator(varyings.begin()),
+                             std::make_move_iterator(varyings.end()));
+      varyings = std::move(visibleVaryings);
+    }
+
+    calls = CallGraph::build(scope, get_allocator());
+  }
+
+private:
+  template <typename Visitor>
+  void visit(Visitor &visitor,
+             std::pmr::unordered_set<const Context *> &visited) const {
+    if (!visited.insert(this).second) {
+      return;
+    }
+
+    for (const auto &include : includes) {
+      include->visit(visitor, visited);
+    }
+
+    visitor(*this);
+  }
 };
 
 } // namespace ryuko
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <ryuko/core.hpp>
+#include <ryuko/pool.hpp>
+#include <ryuko/prelude.hpp>
 
 namespace ryuko {
 
@@ -11,17 +13,26 @@ struct Emitter {
   };
 
   struct State {
-    std::unordered_set<std::string> emittedFunctions{};
-    std::unordered_set<std::string> emittedFunctionSignatures{};
-    std::string output{};
+    //  @note: by index into Context::scope, so every overload is emitted
+    std::pmr::unordered_set<uint32_t> emittedFunctions;
+    std::pmr::unordered_set<uint32_t> emittedFunctionSignatures;
+    std::string output;
     Context &context;
     Function *main;
+    uint32_t mainIndex;
     uint32_t varyingInputIndex;
     uint32_t varyingOutputIndex;
 
   public:
-    explicit State(Context &context, const std::string &mainFn)
-        : context(context), main(nullptr), varyingInputIndex(0),
+    //  @note: scratch sets share the context's allocator unless given one
+    explicit State(Context &context, const std::string_view mainFn)
+        : State(context, mainFn, context.get_allocator()) {}
+
+    State(Context &context, const std::string_view mainFn,
+          const Allocator &allocator)
+        : emittedFunctions(allocator), emittedFunctionSignatures(allocator),
+          context(context),
+          main(nullptr), mainIndex(0), varyingInputIndex(0),
           varyingOutputIndex(0) {
       for (auto &f : context.functions) {
         if (f.name == mainFn) {
@@ -29,6 +40,48 @@ struct Emitter {
           break;
         }
       }
+
+      if (main) {
+        const auto it = std::ranges::find(context.scope, main);
+        mainIndex = static_cast<uint32_t>(it - context.scope.begin());
+      }
+
+      if (main) {
+        output.reserve(sizeHint(context));
+      }
+    }
+
+    /*
+     *  Upper bound on a stage's output: every body, signature and declaration
+     *  of the context plus some slack for the fixed lines, so the output is
+     *  allocated once and everything is formatted straight into it.
+     */
+    [[nodiscard]] static size_t sizeHint(const Context &context) {
+      size_t size = 512;
+
+      for (const auto *function : context.scope) {
+        size += 2 * (function->returnType.size() + function->name.size() + 8) +
+                function->body.size();
+
+        for (const auto &arg : function->args) {
+          size += 2 * (arg.type.size() + arg.name.size() + 3);
+        }
+      }
+
+      for (const auto &varying : context.varyings) {
+        size += varying.type.size() + varying.name.size() +
+                varying.precision.size() + 32;
+      }
+
+      for (const auto &directive : context.directives) {
+        size += directive.size() + 2;
+      }
+
+      for (const auto &code : context.inlinedFragmentCode) {
+        size += code.size() + 1;
+      }
+
+      return size;
     }
   };
 
@@ -40,8 +93,8 @@ public:
 
 public:
   static void function(const Function &function, State &state) {
-    std::string functionName = function.name;
-    std::string functionReturnType = function.returnType;
+    std::string_view functionName = function.name;
+    std::string_view functionReturnType = function.returnType;
 
     if (function.name == VertFunctionName) {
       functionName = "main";
@@ -53,34 +106,25 @@ public:
       functionReturnType = "void";
     }
 
-    state.output += fmt::format("{} {}(", functionReturnType, functionName);
-
-    for (size_t a = 0; a < function.args.size(); a++) {
-      const auto &[type, name, isArray] = function.args[a];
-      state.output += fmt::format("{} {}{}", type, name,
-                                  a + 1 < function.args.size() ? ", " : "");
-    }
-
-    state.output += fmt::format(") {}{}\n", "{", function.body);
+    write(state, "{} {}(", functionReturnType, functionName);
+    arguments(function, state);
+    write(state, ") {{{}\n", function.body);
   }
 
-  static void functionWithCallees(const Function &_function, State &state) {
-    if (state.emittedFunctions.contains(_function.name)) {
+  static void functionWithCallees(const uint32_t index, State &state) {
+    //  @note: included functions reach shaderc through their #include
+    const auto &_function = *state.context.scope[index];
+    if (!state.context.owns(&_function) ||
+        state.emittedFunctions.contains(index)) {
       return;
     }
 
     function(_function, state);
     newLine(state);
-    state.emittedFunctions.insert(_function.name);
-
-    for (const auto &fn : state.context.functions) {
-      if (fn.name == _function.name) {
-        continue;
-      }
+    state.emittedFunctions.insert(index);
 
-      if (_function.body.find(fn.name) != std::string::npos) {
-        functionWithCallees(fn, state);
-      }
+    for (const auto callee : state.context.calls.callees(index)) {
+      functionWithCallees(callee, state);
     }
   }
 
@@ -90,90 +134,80 @@ public:
       return;
     }
 
-    state.output += fmt::format("{} {}(", function.returnType, function.name);
+    write(state, "{} {}(", function.returnType, function.name);
+    arguments(function, state);
+    state.output += ");\n";
+  }
 
+  static void arguments(const Function &function, State &state) {
     for (size_t a = 0; a < function.args.size(); a++) {
       const auto &[type, name, isArray] = function.args[a];
-      state.output += fmt::format("{} {}{}", type, name,
-                                  a + 1 < function.args.size() ? ", " : "");
+      write(state, "{} {}{}", type, name,
+            a + 1 < function.args.size() ? ", " : "");
     }
-
-    state.output += ");\n";
   }
 
-  static void functionSignatureWithCallees(const Function &function,
+  static void functionSignatureWithCallees(const uint32_t index,
                                            State &state) {
-    if (state.emittedFunctionSignatures.contains(function.name)) {
+    const auto &function = *state.context.scope[index];
+    if (!state.context.owns(&function) ||
+        state.emittedFunctionSignatures.contains(index)) {
       return;
     }
 
     if (function.name != VertFunctionName &&
         function.name != FragFunctionName) {
       functionSignature(function, state);
-      state.emittedFunctionSignatures.insert(function.name);
+      state.emittedFunctionSignatures.insert(index);
     }
 
-    for (const auto &fn : state.context.functions) {
-      if (fn.name == function.name) {
-        continue;
-      }
-
-      if (function.body.find(fn.name) != std::string::npos) {
-        functionSignatureWithCallees(fn, state);
-      }
+    for (const auto callee : state.context.calls.callees(index)) {
+      functionSignatureWithCallees(callee, state);
     }
   }
 
   static void newLine(State &state) { state.output += '\n'; }
 
-  static Optional<Output> program(Context &context) {
-    State fragment{context, FragFunctionName};
-    State vertex{context, VertFunctionName};
+  template <typename... Args>
+  static void write(State &state, fmt::format_string<Args...> format,
+                    Args &&...args) {
+    fmt::format_to(std::back_inserter(state.output), format,
+                   std::forward<Args>(args)...);
+  }
+
+  [[nodiscard]] static bool writes(const Function &function,
+                                   const std::string_view variable) {
+    return function.ast.writes(variable, function.body);
+  }
 
-    version(vertex);
-    newLine(vertex);
+  /*
+   *  With Execution::Parallel, the functions of the fragment stage are
+   *  emitted on the shared WorkerPool while the vertex stage's are emitted on
+   *  the calling thread.
+   */
+  static Optional<Output>
+  program(Context &context, const Execution execution = Execution::Serial) {
+    //  @note: the context's arena is not thread-safe, stages emitted
+    //  concurrently keep their scratch sets on the heap
+    const auto allocator = execution == Execution::Parallel
+                               ? Allocator{std::pmr::new_delete_resource()}
+                               : context.get_allocator();
+
+    State fragment{context, FragFunctionName, allocator};
+    State vertex{context, VertFunctionName, allocator};
 
     if (!vertex.main) {
       error("no vertex main function");
       return {};
     }
 
-    if (fragment.main) {
-      version(fragment);
-      newLine(fragment);
-    }
-
-    std::vector<std::string> extensions{
-        "precision mediump int;",
-        "precision highp float;",
-        "#extension GL_EXT_buffer_reference: require",
-        // "#extension GL_EXT_debug_printf: require",
-        "const float PI = 3.14159265359;",
-    };
-
-    for (const auto &extension : extensions) {
-      vertex.output += extension;
-      newLine(vertex);
-
-      if (fragment.main) {
-        fragment.output += extension;
-        newLine(fragment);
-      }
-    }
-
-    for (const auto &directive : context.directives) {
-      vertex.output += fmt::format("#{}", directive);
-      newLine(vertex);
-
-      if (fragment.main) {
-        fragment.output += fmt::format("#{}", directive);
-        newLine(fragment);
-      }
-    }
+    const auto prelude = Prelude::write(context, vertex.output);
 
     if (fragment.main) {
+      fragment.output.append(vertex.output, prelude);
+
       for (const auto &code : context.inlinedFragmentCode) {
-        fragment.output += fmt::format("{}", code);
+        fragment.output += code;
         newLine(fragment);
       }
     }
@@ -181,14 +215,13 @@ public:
     //  @temp(v2f): mark inputs/outputs
     if (fragment.main) {
       for (auto &varying : fragment.context.varyings) {
-        if (const auto &assignment = fmt::format(" {} =", varying.name);
-            vertex.main->body.find(assignment) != std::string::npos) {
+        if (writes(*vertex.main, varying.name)) {
           varyingOutput(varying, vertex);
           varyingInput(varying, fragment);
 
           varying.fragmentInput = true;
           varying.vertexOutput = true;
-        } else if (fragment.main->body.find(assignment) != std::string::npos) {
+        } else if (writes(*fragment.main, varying.name)) {
           varyingOutput(varying, fragment);
 
           varying.fragmentOutput = true;
@@ -215,64 +248,61 @@ public:
       newLine(fragment);
     }
 
-    functionSignatureWithCallees(*vertex.main, vertex);
-
-    if (fragment.main) {
-      functionSignatureWithCallees(*fragment.main, fragment);
-    }
-
-    if (!vertex.emittedFunctionSignatures.empty()) {
-      newLine(vertex);
-    }
-
-    if (fragment.main && !fragment.emittedFunctionSignatures.empty()) {
-      newLine(fragment);
-    }
+    if (fragment.main && execution == Execution::Parallel) {
+      auto &pool = WorkerPool::shared();
 
-    functionWithCallees(*vertex.main, vertex);
+      auto pending = pool.submit([&fragment] { functions(fragment); });
+      functions(vertex);
+      pool.wait(pending);
+    } else {
+      functions(vertex);
 
-    if (fragment.main) {
-      functionWithCallees(*fragment.main, fragment);
+      if (fragment.main) {
+        functions(fragment);
+      }
     }
 
     Output result{};
-    result.vertex = vertex.output;
+    result.vertex = std::move(vertex.output);
 
     if (fragment.main) {
-      result.fragment = fragment.output;
+      result.fragment = std::move(fragment.output);
     }
 
     return result;
   }
 
-  static void varyingInput(const Varying &varying, State &state) {
-    state.output +=
-        fmt::format("layout (location = {}) in", state.varyingInputIndex);
+  //  @note: only touches the stage's own state, stages can run concurrently
+  static void functions(State &state) {
+    functionSignatureWithCallees(state.mainIndex, state);
 
-    if (!varying.precision.empty()) {
-      state.output += fmt::format(" {}", varying.precision);
+    if (!state.emittedFunctionSignatures.empty()) {
+      newLine(state);
     }
 
-    state.output += fmt::format(" {} {};\n", varying.type, varying.name);
+    functionWithCallees(state.mainIndex, state);
+  }
+
+  static void varyingInput(const Varying &varying, State &state) {
+    write(state, "layout (location = {}) in", state.varyingInputIndex);
+    declaration(varying, state);
 
     state.varyingInputIndex++;
   }
 
   static void varyingOutput(const Varying &varying, State &state) {
-    state.output +=
-        fmt::format("layout (location = {}) out", state.varyingOutputIndex);
-
-    if (!varying.precision.empty()) {
-      state.output += fmt::format(" {}", varying.precision);
-    }
-
-    state.output += fmt::format(" {} {};\n", varying.type, varying.name);
+    write(state, "layout (location = {}) out", state.varyingOutputIndex);
+    declaration(varying, state);
 
     state.varyingOutputIndex++;
   }
 
-  static void version(State &state) {
-    state.output += fmt::format("#version {}\n", state.context.version);
+  static void declaration(const Varying &varying, State &state) {
+    if (!varying.precision.empty()) {
+      write(state, " {}", varying.precision);
+    }
+
+    write(state, " {} {};\n", varying.type, varying.name);
   }
 };
 
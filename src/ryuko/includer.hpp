@@ -2,38 +2,162 @@
 
 #include <ryuko/pch.hpp>
 
+#include <ryuko/vfs.hpp>
+
 namespace ryuko {
 
+/*
+ *  Every file a compilation session reads, loaded once through the session's
+ *  SourceProvider and kept for the whole session. The parser and shaderc
+ *  resolve includes through the same instance, so a file is opened once and
+ *  both read the same buffer.
+ *
+ *  @note: files are never dropped, content views stay valid as long as the
+ *  resolver does
+ */
+class IncludeResolver final {
+public:
+  struct File {
+    std::string path;
+    SourceFile source;
+
+    //  of the content, for telling whether a parse of the file is current
+    size_t hash;
+
+  public:
+    [[nodiscard]] std::string_view content() const { return source.content(); }
+  };
+
+private:
+  std::shared_ptr<SourceProvider> provider;
+  std::vector<std::filesystem::path> searchPaths;
+
+  mutable std::mutex mutex;
+  std::unordered_map<std::string, std::unique_ptr<const File>> files;
+
+public:
+  explicit IncludeResolver(
+      std::shared_ptr<SourceProvider> provider =
+          std::make_shared<DiskSourceProvider>(),
+      std::vector<std::filesystem::path> searchPaths = {})
+      : provider(std::move(provider)), searchPaths(std::move(searchPaths)) {}
+
+public:
+  [[nodiscard]] std::string identity(const std::filesystem::path &path) const {
+    return provider->identity(path);
+  }
+
+  //  @note: nullptr if the file cannot be read, failures are not remembered
+  [[nodiscard]] const File *load(const std::filesystem::path &path) {
+    auto key = provider->identity(path);
+
+    {
+      std::lock_guard lock{mutex};
+      if (const auto it = files.find(key); it != files.end()) {
+        return it->second.get();
+      }
+    }
+
+    auto source = provider->open(path);
+    if (!source.has_value()) {
+      return nullptr;
+    }
+
+    const auto hash = std::hash<std::string_view>{}(source->content());
+    auto file =
+        std::make_unique<const File>(key, std::move(source.value()), hash);
+
+    //  @note: another thread may have loaded it meanwhile, keep the first
+    std::lock_guard lock{mutex};
+    const auto [it, inserted] = files.try_emplace(std::move(key));
+    if (inserted) {
+      it->second = std::move(file);
+    }
+
+    return it->second.get();
+  }
+
+  /*
+   *  `#include "file"` is looked up next to the including file first, then
+   *  in the search paths in order, `#include <file>` in the search paths
+   *  only.
+   */
+  [[nodiscard]] const File *
+  include(const std::string_view requestedSource,
+          const std::filesystem::path &requestingSource, const bool relative) {
+    if (relative) {
+      if (const auto *file =
+              load(requestingSource.parent_path() / requestedSource)) {
+        return file;
+      }
+    }
+
+    for (const auto &searchPath : searchPaths) {
+      if (const auto *file = load(searchPath / requestedSource)) {
+        return file;
+      }
+    }
+
+    return nullptr;
+  }
+
+  [[nodiscard]] size_t size() const {
+    std::lock_guard lock{mutex};
+    return files.size();
+  }
+};
+
+/*
+ *  Resolves includes for shaderc from the session's IncludeResolver, the
+ *  results point straight into its buffers. Every file is handed out once
+ *  per compilation, later requests for it get an empty body, as with
+ *  #pragma once, so a file reached through several includes is compiled
+ *  once.
+ */
 class CustomIncluder final : public shaderc::CompileOptions::IncluderInterface {
+  std::shared_ptr<IncludeResolver> resolver;
+  std::unordered_set<std::string_view> included;
+
 public:
+  explicit CustomIncluder(std::shared_ptr<IncludeResolver> resolver =
+                              std::make_shared<IncludeResolver>())
+      : resolver(std::move(resolver)) {}
+
+public:
+  //  @note: starts a new compilation, files handed out before count as unseen
+  void bind(std::shared_ptr<IncludeResolver> resolver) {
+    this->resolver = std::move(resolver);
+    included.clear();
+  }
+
   shaderc_include_result *
   GetInclude(const char *requestedSource, shaderc_include_type type,
              const char *requestingSource,
              [[maybe_unused]] size_t includeDepth) override {
-    if (type != shaderc_include_type_relative) {
-      error("only relative includes are supported right now\n  {} requested by "
-            "{}",
-            requestedSource, requestingSource);
-      return nullptr;
-    }
-
-    std::filesystem::path path{requestingSource};
-    std::ifstream file(path.parent_path() / requestedSource);
-    if (!file.is_open()) {
+    const auto *file =
+        resolver ? resolver->include(requestedSource, requestingSource,
+                                     type == shaderc_include_type_relative)
+                 : nullptr;
+    if (!file) {
       return make_error_result(fmt::format(
           "[shaderc][include] {} tried to include {}, but file not found.",
-          path.c_str(), (path.parent_path() / requestedSource).c_str()));
+          requestingSource, requestedSource));
     }
 
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    auto *content = new std::string(buffer.str());
+    //  @note: the resolved path is the name nested includes are relative to
+    const auto content =
+        included.insert(file->path).second ? file->content() : "";
 
-    return new shaderc_include_result{requestedSource, strlen(requestedSource),
-                                      content->c_str(), content->size(),
-                                      content};
+    //  @note: nothing to own, no user_data
+    return new shaderc_include_result{file->path.c_str(), file->path.size(),
+                                      content.data(), content.size(), nullptr};
   }
 
+  /*
+   *  @note: user_data owns the result's memory, if any: null for resolved
+   *  includes, which point into the resolver, and the error message string
+   *  for failed ones, see make_error_result()
+   */
   void ReleaseInclude(shaderc_include_result *includeResult) override {
     if (includeResult) {
       delete static_cast<std::string *>(includeResult->user_data);
@@ -42,12 +166,14 @@ public:
   }
 
 private:
-  shaderc_include_result *make_error_result(const std::string &errorMessage) {
-    const auto content = new std::string(errorMessage);
-    return new shaderc_include_result{errorMessage.c_str(), errorMessage.size(),
-                                      content->c_str(), content->size(),
-                                      content};
+  shaderc_include_result *make_error_result(std::string errorMessage) {
+    //  @note: an empty source name is how shaderc recognizes a failed include.
+    //  The message is owned through user_data, ReleaseInclude() frees it.
+    auto *message = new std::string{std::move(errorMessage)};
+
+    return new shaderc_include_result{"", 0, message->data(), message->size(),
+                                      message};
   }
 };
 
-} // namespace ryuko
\ No newline at end of file
+} // namespace ryuko
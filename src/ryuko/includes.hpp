@@ -0,0 +1,154 @@
+#pragma once
+
+#include <ryuko/core.hpp>
+#include <ryuko/includer.hpp>
+
+namespace ryuko {
+
+/*
+ *  A Context with the arena it allocates from, for contexts that outlive the
+ *  compilation that parsed them.
+ */
+struct OwnedContext {
+  //  @note: a typical include is a handful of declarations and helpers
+  static constexpr size_t ArenaInitialSize = 16 * 1024;
+
+public:
+  std::pmr::monotonic_buffer_resource arena{ArenaInitialSize};
+  Optional<Context> context;
+
+public:
+  OwnedContext() = default;
+  OwnedContext(const OwnedContext &) = delete;
+  OwnedContext &operator=(const OwnedContext &) = delete;
+};
+
+/*
+ *  Parsed includes shared by every shader of the process. An include is
+ *  parsed once into a Context of its own and handed out as a const, shared
+ *  reference that parents link to instead of copying its declarations.
+ *
+ *  Entries are keyed by canonical path and checked against a hash of the
+ *  content of the include and of every file it pulls in, so editing the
+ *  file or any of its nested includes parses it again and replaces its old
+ *  entry.
+ */
+class IncludeCache final {
+public:
+  struct Key {
+    std::string path;
+    size_t hash;
+
+  public:
+    bool operator==(const Key &) const = default;
+  };
+
+private:
+  struct Entry {
+    size_t hash;
+
+    //  every file the include pulls in, as it was when parsed
+    std::vector<Key> dependencies;
+    std::shared_ptr<const Context> context;
+  };
+
+  mutable std::mutex mutex;
+  std::unordered_map<std::string, Entry> entries;
+
+public:
+  [[nodiscard]] static IncludeCache &shared() {
+    static IncludeCache cache;
+    return cache;
+  }
+
+  [[nodiscard]] static Key key(const IncludeResolver::File &file) {
+    return Key{file.path, file.hash};
+  }
+
+public:
+  /*
+   *  @note: nested includes are read through `resolver` to tell whether they
+   *  changed, the shader pulls them in anyway
+   */
+  [[nodiscard]] std::shared_ptr<const Context>
+  find(const Key &key, IncludeResolver &resolver) const {
+    std::shared_ptr<const Context> context;
+    std::vector<Key> dependencies;
+
+    {
+      std::lock_guard lock{mutex};
+
+      const auto it = entries.find(key.path);
+      if (it == entries.end() || it->second.hash != key.hash) {
+        return nullptr;
+      }
+
+      context = it->second.context;
+      dependencies = it->second.dependencies;
+    }
+
+    for (const auto &dependency : dependencies) {
+      const auto *file = resolver.load(dependency.path);
+      if (!file || file->hash != dependency.hash) {
+        return nullptr;
+      }
+    }
+
+    return context;
+  }
+
+  //  @note: if another thread parsed the same content first, its copy wins
+  std::shared_ptr<const Context>
+  insert(const Key &key, std::shared_ptr<const Context> context) {
+    auto dependencies = dependenciesOf(*context);
+
+    std::lock_guard lock{mutex};
+
+    auto &entry = entries[key.path];
+    if (entry.context && entry.hash == key.hash &&
+        entry.dependencies == dependencies) {
+      return entry.context;
+    }
+
+    entry = Entry{key.hash, std::move(dependencies), std::move(context)};
+    return entry.context;
+  }
+
+  //  @note: drops the files and every include that pulls one of them in
+  void evict(const std::unordered_set<std::string> &files) {
+    std::lock_guard lock{mutex};
+
+    std::erase_if(entries, [&files](const auto &item) {
+      const auto &[path, entry] = item;
+      return files.contains(path) ||
+             std::ranges::any_of(entry.dependencies, [&files](const Key &key) {
+               return files.contains(key.path);
+             });
+    });
+  }
+
+  void clear() {
+    std::lock_guard lock{mutex};
+    entries.clear();
+  }
+
+  [[nodiscard]] size_t size() const {
+    std::lock_guard lock{mutex};
+    return entries.size();
+  }
+
+private:
+  [[nodiscard]] static std::vector<Key>
+  dependenciesOf(const Context &context) {
+    std::vector<Key> dependencies;
+    context.visit([&](const Context &visible) {
+      if (&visible != &context) {
+        dependencies.push_back(Key{std::string{visible.path}, visible.hash});
+      }
+    });
+
+    return dependencies;
+  }
+};
+
+} // namespace ryuko
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <ryuko/pch.hpp>
+
+namespace ryuko {
+
+enum class Keyword : uint8_t {
+  None,
+
+  Layout,
+  Const,
+  Varying,
+  Uniform,
+  Buffer,
+  Readonly,
+
+  //  statements
+  If,
+  Else,
+  For,
+  While,
+  Do,
+  Switch,
+  Case,
+  Default,
+  Return,
+  Break,
+  Continue,
+  Discard,
+
+  //  declaration qualifiers
+  Highp,
+  Mediump,
+  Lowp,
+  Precise,
+  Invariant,
+
+  //  layout qualifiers
+  Set,
+  Binding,
+  PushConstant,
+  BufferReference,
+
+  //  pipeline configuration variables
+  ColorBlend,
+  DepthTest,
+  DepthWrite,
+  DepthOp,
+  Polygon,
+  Cull,
+  FrontFace,
+  Topology,
+  Multisampling,
+  ColorAttachmentCount,
+  DepthAttachment,
+};
+
+/*
+ *  Compile-time perfect hash over every keyword the parser dispatches on. The
+ *  seed is searched for at compile time so that no two keywords share a slot,
+ *  a lookup is then one hash, one load and one string compare.
+ */
+namespace keywords {
+
+struct Entry {
+  std::string_view text;
+  Keyword keyword;
+};
+
+inline constexpr Entry entries[] = {
+    {"layout", Keyword::Layout},
+    {"const", Keyword::Const},
+    {"varying", Keyword::Varying},
+    {"uniform", Keyword::Uniform},
+    {"buffer", Keyword::Buffer},
+    {"readonly", Keyword::Readonly},
+    {"if", Keyword::If},
+    {"else", Keyword::Else},
+    {"for", Keyword::For},
+    {"while", Keyword::While},
+    {"do", Keyword::Do},
+    {"switch", Keyword::Switch},
+    {"case", Keyword::Case},
+    {"default", Keyword::Default},
+    {"return", Keyword::Return},
+    {"break", Keyword::Break},
+    {"continue", Keyword::Continue},
+    {"discard", Keyword::Discard},
+    {"highp", Keyword::Highp},
+    {"mediump", Keyword::Mediump},
+    {"lowp", Keyword::Lowp},
+    {"precise", Keyword::Precise},
+    {"invariant", Keyword::Invariant},
+    {"set", Keyword::Set},
+    {"binding", Keyword::Binding},
+    {"push_constant", Keyword::PushConstant},
+    {"buffer_reference", Keyword::BufferReference},
+    {"color_blend", Keyword::ColorBlend},
+    {"depth_test", Keyword::DepthTest},
+    {"depth_write", Keyword::DepthWrite},
+    {"depth_op", Keyword::DepthOp},
+    {"polygon", Keyword::Polygon},
+    {"cull", Keyword::Cull},
+    {"front_face", Keyword::FrontFace},
+    {"topology", Keyword::Topology},
+    {"multisampling", Keyword::Multisampling},
+    {"color_attachment_count", Keyword::ColorAttachmentCount},
+    {"depth_attachment", Keyword::DepthAttachment},
+};
+
+inline constexpr size_t TableSize = 256;
+
+static_assert(std::size(entries) < TableSize);
+static_assert(std::size(entries) < std::numeric_limits<uint8_t>::max());
+static_assert(TableSize <= std::numeric_limits<uint8_t>::max() + 1);
+
+[[nodiscard]] constexpr uint32_t hash(const std::string_view text,
+                                      const uint32_t seed) {
+  uint32_t h = seed ^ static_cast<uint32_t>(text.size());
+  for (const char c : text) {
+    h = (h ^ static_cast<uint8_t>(c)) * 16777619u;
+  }
+
+  return h;
+}
+
+[[nodiscard]] consteval uint32_t findSeed() {
+  for (uint32_t seed = 2166136261u;; seed++) {
+    bool used[TableSize]{};
+    bool collision = false;
+
+    for (const auto &entry : entries) {
+      auto &slot = used[hash(entry.text, seed) % TableSize];
+      if (slot) {
+        collision = true;
+        break;
+      }
+
+      slot = true;
+    }
+
+    if (!collision) {
+      return seed;
+    }
+  }
+}
+
+inline constexpr uint32_t Seed = findSeed();
+
+//  @note: slot holds the entry index + 1, 0 means empty
+inline constexpr auto table = [] {
+  std::array<uint8_t, TableSize> slots{};
+  for (size_t i = 0; i < std::size(entries); i++) {
+    slots[hash(entries[i].text, Seed) % TableSize] = static_cast<uint8_t>(i + 1);
+  }
+
+  return slots;
+}();
+
+[[nodiscard]] constexpr Keyword lookup(const std::string_view text) {
+  const auto slot = table[hash(text, Seed) % TableSize];
+  if (slot == 0) {
+    return Keyword::None;
+  }
+
+  const auto &entry = entries[slot - 1];
+  return entry.text == text ? entry.keyword : Keyword::None;
+}
+
+[[nodiscard]] constexpr bool configuration(const Keyword keyword) {
+  return keyword >= Keyword::ColorBlend && keyword <= Keyword::DepthAttachment;
+}
+
+[[nodiscard]] constexpr bool qualifier(const Keyword keyword) {
+  return keyword == Keyword::Const ||
+         (keyword >= Keyword::Highp && keyword <= Keyword::Invariant);
+}
+
+static_assert(lookup("layout") == Keyword::Layout);
+static_assert(lookup("depth_attachment") == Keyword::DepthAttachment);
+static_assert(lookup("vec4") == Keyword::None);
+
+} // namespace keywords
+
+} // namespace ryuko
@@ -0,0 +1,259 @@
+#pragma once
+
+#include <ryuko/pch.hpp>
+
+#include <ryuko/scan.hpp>
+
+namespace ryuko {
+
+struct Token {
+  enum class Kind {
+    End,
+    Identifier,
+    Number,
+    Punctuation,
+    Directive,
+    String,
+  };
+
+public:
+  Kind kind = Kind::End;
+
+  //  @note: views into the lexer input, never owned
+  std::string_view text;
+  size_t offset = 0;
+
+public:
+  [[nodiscard]] bool end() const { return kind == Kind::End; }
+
+  [[nodiscard]] bool word() const {
+    return kind == Kind::Identifier || kind == Kind::Number;
+  }
+
+  [[nodiscard]] bool is(const char punctuation) const {
+    return kind == Kind::Punctuation && text.size() == 1 &&
+           text[0] == punctuation;
+  }
+
+  [[nodiscard]] bool is(const std::string_view identifier) const {
+    return word() && text == identifier;
+  }
+};
+
+/*
+ *  Splits a source buffer into tokens without copying it. Whitespace and
+ *  comments are skipped, directives are returned as a single token holding
+ *  everything after the '#' up to the end of the line.
+ */
+struct Lexer {
+private:
+  std::string_view input;
+  size_t index;
+
+public:
+  explicit Lexer(const std::string_view input) : input(input), index(0) {}
+
+public:
+  [[nodiscard]] static bool alphanumeric(const char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+  }
+
+  [[nodiscard]] static bool digit(const char c) {
+    return c >= '0' && c <= '9';
+  }
+
+  [[nodiscard]] static bool whitespace(const char c) {
+    return std::isspace(static_cast<unsigned char>(c));
+  }
+
+  [[nodiscard]] bool done() const { return index >= input.size(); }
+
+  [[nodiscard]] size_t offset() const { return index; }
+
+  void rewind(const size_t offset) { index = offset; }
+
+  [[nodiscard]] std::string_view source() const { return input; }
+
+  [[nodiscard]] char at(const size_t i) const {
+    return i < input.size() ? input[i] : '\0';
+  }
+
+  Token next() {
+    skipTrivia();
+
+    Token token{};
+    token.offset = index;
+
+    if (done()) {
+      return token;
+    }
+
+    const char c = input[index];
+
+    if (c == '#') {
+      const auto start = ++index;
+      skipLine();
+
+      auto end = index;
+      while (end > start && whitespace(input[end - 1])) {
+        end--;
+      }
+
+      token.kind = Token::Kind::Directive;
+      token.text = input.substr(start, end - start);
+      return token;
+    }
+
+    if (c == '"') {
+      const auto start = index++;
+      while (!done() && input[index] != '"' && input[index] != '\n') {
+        index += input[index] == '\\' ? 2 : 1;
+      }
+
+      index = std::min(index + 1, input.size());
+
+      token.kind = Token::Kind::String;
+      token.text = input.substr(start, index - start);
+      return token;
+    }
+
+    if (digit(c) || (c == '.' && digit(at(index + 1)))) {
+      const auto start = index;
+      while (!done()) {
+        const char n = input[index];
+        if (alphanumeric(n) || n == '.') {
+          index++;
+        } else if ((n == '+' || n == '-') &&
+                   (input[index - 1] == 'e' || input[index - 1] == 'E') &&
+                   !(index - start > 1 && (input[start + 1] == 'x' ||
+                                           input[start + 1] == 'X'))) {
+          index++;
+        } else {
+          break;
+        }
+      }
+
+      token.kind = Token::Kind::Number;
+      token.text = input.substr(start, index - start);
+      return token;
+    }
+
+    if (alphanumeric(c)) {
+      const auto start = index;
+      while (!done() && alphanumeric(input[index])) {
+        index++;
+      }
+
+      token.kind = Token::Kind::Identifier;
+      token.text = input.substr(start, index - start);
+      return token;
+    }
+
+    token.kind = Token::Kind::Punctuation;
+    token.text = input.substr(index, punctuationLength());
+    index += token.text.size();
+
+    return token;
+  }
+
+  [[nodiscard]] Token peek() {
+    const auto start = index;
+    const auto token = next();
+    index = start;
+
+    return token;
+  }
+
+  //  @note: stops on the newline, it is left for skipTrivia()
+  std::string_view skipLine() {
+    const auto start = index;
+    index = scan::findFirstOf<'\n'>(input, index);
+
+    return input.substr(start, index - start);
+  }
+
+  /*
+   *  Skips to the '}' closing the scope that was just opened, honouring nested
+   *  scopes, comments and strings. Jumps between the interesting bytes rather
+   *  than tokenizing, returns false if the input ends first.
+   */
+  bool skipBlock() {
+    size_t scopes = 1;
+
+    while (scopes) {
+      index = scan::findFirstOf<'{', '}', '/', '"'>(input, index);
+      if (done()) {
+        return false;
+      }
+
+      switch (input[index++]) {
+      case '{':
+        scopes++;
+        break;
+      case '}':
+        scopes--;
+        break;
+      case '/':
+        if (at(index) == '/') {
+          skipLine();
+        } else if (at(index) == '*') {
+          const auto end = input.find("*/", index + 1);
+          index = end == std::string_view::npos ? input.size() : end + 2;
+        }
+        break;
+      case '"':
+        index = scan::findFirstOf<'"', '\n'>(input, index);
+        index = std::min(index + 1, input.size());
+        break;
+      default:
+        break;
+      }
+    }
+
+    return true;
+  }
+
+  void skipTrivia() {
+    while (!done()) {
+      if (whitespace(input[index])) {
+        index++;
+      } else if (input[index] == '/' && at(index + 1) == '/') {
+        skipLine();
+      } else if (input[index] == '/' && at(index + 1) == '*') {
+        const auto end = input.find("*/", index + 2);
+        index = end == std::string_view::npos ? input.size() : end + 2;
+      } else {
+        break;
+      }
+    }
+  }
+
+  //  @note: raw scan, does not tokenize what it skips over
+  std::string_view until(const std::string_view expected) {
+    const auto start = index;
+    const auto end = input.find(expected, index);
+    index = end == std::string_view::npos ? input.size() : end;
+
+    return input.substr(start, index - start);
+  }
+
+private:
+  [[nodiscard]] size_t punctuationLength() const {
+    static constexpr std::string_view operators[] = {
+        "<<=", ">>=", "++", "--", "<<", ">>", "<=", ">=", "==", "!=",
+        "&&",  "||",  "^^", "+=", "-=", "*=", "/=", "%=", "&=", "|=",
+        "^=",
+    };
+
+    const auto rest = input.substr(index);
+    for (const auto &op : operators) {
+      if (rest.starts_with(op)) {
+        return op.size();
+      }
+    }
+
+    return 1;
+  }
+};
+
+} // namespace ryuko
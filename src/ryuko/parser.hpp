@@ -2,450 +2,394 @@
 
 #include <ryuko/core.hpp>
 #include <ryuko/includer.hpp>
+#include <ryuko/includes.hpp>
+#include <ryuko/keywords.hpp>
+#include <ryuko/lexer.hpp>
 
 namespace ryuko {
 
+/*
+ *  @note: the parser does not own its input, the buffer has to outlive it.
+ *  Everything stored in the resulting Context is copied out of the buffer.
+ */
 struct Parser {
+  struct LayoutQualifiers {
+    Optional<uint32_t> set;
+    Optional<uint32_t> binding;
+    uint32_t standard = 0;
+    bool pushConstant = false;
+    bool bufferReference = false;
+    bool readonly = false;
+  };
+
 private:
-  std::string input;
-  size_t index;
-  CustomIncluder includer;
+  Lexer lexer;
   std::filesystem::path inputPath;
+  Allocator allocator;
+  std::shared_ptr<IncludeResolver> resolver;
+  IncludeCache &includeCache;
 
-public:
-  explicit Parser(std::string input,
-                  const std::filesystem::path &inputPath = {})
-      : input(std::move(input)), index(0), inputPath(inputPath) {}
+  //  @note: the file including this one, the chain is the include stack
+  const Parser *parent = nullptr;
+  std::string canonicalPath;
+
+  //  set when an include was dropped, so the result is not worth caching
+  bool incomplete = false;
 
 public:
-  [[nodiscard]] bool alphanumeric(const size_t i) const {
-    return std::isalnum(input[i]) || input[i] == '_';
-  }
+  explicit Parser(
+      const std::string_view input, const std::filesystem::path &inputPath = {},
+      std::pmr::memory_resource *resource = std::pmr::get_default_resource(),
+      std::shared_ptr<IncludeResolver> resolver =
+          std::make_shared<IncludeResolver>(),
+      IncludeCache &includeCache = IncludeCache::shared())
+      : lexer(input), inputPath(inputPath), allocator(resource),
+        resolver(std::move(resolver)), includeCache(includeCache) {}
 
-  Optional<config::ConfigValue> consumePipelineConfigurationVariable() {
-    const auto start = index;
+public:
+  [[nodiscard]] static uint32_t integer(const std::string_view text) {
+    uint32_t value = 0;
+    std::from_chars(text.data(), text.data() + text.size(), value);
 
-    const auto prop = consumeIdentifier();
-    consumeWhitespace();
+    return value;
+  }
 
-    const auto it = config::variableTypeMap.find(prop);
-    if (it == config::variableTypeMap.end()) {
-      index = start;
-      return {};
-    }
+  Optional<config::ConfigValue>
+  consumePipelineConfigurationVariable(const Keyword keyword) {
+    consumeIdentifier();
 
     const auto value = consumeIdentifier();
-    consumeWhitespace();
 
     if (!expect(';', __LINE__)) {
-      index = start;
       return {};
     }
 
-    switch (it->second) {
-    case 0: { // color_blend
+    switch (keyword) {
+    case Keyword::ColorBlend: {
       const auto val = config::ColorBlend::parse(value);
       if (!val) {
-        index = start;
         return {};
       }
       return config::ColorBlend{*val};
     }
-    case 1: { // depth_test
+    case Keyword::DepthTest: {
       const auto val = config::DepthTest::parse(value);
       if (!val) {
-        index = start;
         return {};
       }
       return config::DepthTest{*val};
     }
-    case 2: { // depth_write
+    case Keyword::DepthWrite: {
       const auto val = config::DepthWrite::parse(value);
       if (!val) {
-        index = start;
         return {};
       }
       return config::DepthWrite{*val};
     }
-    case 3: { // depth_op
+    case Keyword::DepthOp: {
       const auto val = config::DepthOp::parse(value);
       if (!val) {
-        index = start;
         return {};
       }
       return config::DepthOp{*val};
     }
-    case 4: { // polygon
+    case Keyword::Polygon: {
       const auto val = config::Polygon::parse(value);
       if (!val) {
-        index = start;
         return {};
       }
       return config::Polygon{*val};
     }
-    case 5: { // cull
+    case Keyword::Cull: {
       const auto val = config::Cull::parse(value);
       if (!val) {
-        index = start;
         return {};
       }
       return config::Cull{*val};
     }
-    case 6: { // front_face
+    case Keyword::FrontFace: {
       const auto val = config::FrontFace::parse(value);
       if (!val) {
-        index = start;
         return {};
       }
       return config::FrontFace{*val};
     }
-    case 7: { // topology
+    case Keyword::Topology: {
       const auto val = config::Topology::parse(value);
       if (!val) {
-        index = start;
         return {};
       }
       return config::Topology{*val};
     }
-    case 8: { // multisampling
+    case Keyword::Multisampling: {
       const auto val = config::Multisampling::parse(value);
       if (!val) {
-        index = start;
         return {};
       }
       return config::Multisampling{*val};
     }
-    case 9: { // color_attachment_count
+    case Keyword::ColorAttachmentCount: {
       const auto val = config::ColorAttachmentCount::parse(value);
       if (!val) {
-        index = start;
         return {};
       }
       return config::ColorAttachmentCount{*val};
     }
-    case 10: { // depth_attachment
+    case Keyword::DepthAttachment: {
       const auto val = config::DepthAttachment::parse(value);
       if (!val) {
-        index = start;
         return {};
       }
       return config::DepthAttachment{*val};
     }
     default:
-      index = start;
       return {};
     }
   }
 
-  std::string consumeCharacter() { return input.substr(index++, 1); }
+  Token consumeToken() { return lexer.next(); }
 
-  Optional<std::string> consumeConst() {
+  Optional<std::string_view> consumeConst() {
     if (match("const")) {
-      return consumeUntil("\n");
+      return lexer.skipLine();
     }
 
     return {};
   }
 
   Optional<Function> consumeFunction() {
-    const auto start = index;
-    Function function{};
+    Function function{allocator};
 
     function.returnType = consumeIdentifier();
-    consumeWhitespace();
-
     function.name = consumeIdentifier();
-    consumeWhitespace();
 
     if (peek() != '(') {
-      index = start;
       return {};
     }
 
-    consumeCharacter();
-    consumeWhitespace();
+    consumeToken();
 
     if (peek() == ')') {
       //  @note: function has no arguments
-      consumeCharacter();
+      consumeToken();
     } else {
       while (peek() != ')') {
         const auto argType = consumeIdentifier();
-        consumeWhitespace();
-
         const auto argName = consumeIdentifier();
-        consumeWhitespace();
 
-        function.args.push_back(Function::Argument{argType, argName});
+        function.args.emplace_back(argType, argName);
 
         if (peek() == ')') {
           break;
         }
 
         if (!expect(',', __LINE__)) {
-          index = start;
-
           return {};
         }
-
-        consumeWhitespace();
       }
 
-      consumeCharacter();
+      consumeToken();
     }
 
-    consumeWhitespace();
+    if (peek() == ';') {
+      //  @note: prototype, the definition is emitted from its body
+      return {};
+    }
 
     if (!expect('{', __LINE__)) {
-      index = start;
-
       return {};
     }
 
-    size_t scopes = 1;
-    std::vector<std::string> args;
+    const auto bodyStart = lexer.offset();
 
-    while (scopes && !done()) {
-      const auto c = consumeCharacter();
-      if (c == "{") {
-        scopes++;
-      } else if (c == "}") {
-        scopes--;
-      }
-
-      function.body += c;
-    }
-
-    if (scopes) {
+    if (!lexer.skipBlock()) {
       printError('}', __LINE__);
 
-      index = start;
-
       return {};
     }
 
-    return {function};
-  }
-
-  std::string consumeIdentifier() {
-    const auto start = index;
-
-    while (index < input.size() && alphanumeric(index)) {
-      index++;
-    }
+    function.body = lexer.source().substr(bodyStart, lexer.offset() - bodyStart);
+    function.ast = Ast::parse(function.body, allocator);
 
-    return input.substr(start, index - start);
+    return function;
   }
 
-  Optional<std::string> consumeAttributeValue(const std::string &expected) {
-    if (match(expected)) {
-      consumeIdentifier();
-      consumeWhitespace();
-
-      if (!expect('=', __LINE__)) {
-        return {};
-      }
+  std::string_view consumeIdentifier() {
+    const auto start = lexer.offset();
 
-      consumeWhitespace();
-
-      return consumeIdentifier();
+    if (const auto token = consumeToken(); token.word()) {
+      return token.text;
     }
 
+    lexer.rewind(start);
+
     return {};
   }
 
-  Optional<StorageBuffer> consumeStorageBuffer() {
-    /*
-     *  layout (set = 2, binding = 0) buffer Hello {
-     *    uint data[];
-     *  };
-     */
-
-    const auto start = index;
-
+  /*
+   *  layout (set = 2, binding = 0) readonly
+   *  layout (buffer_reference, std430)
+   *  layout (push_constant)
+   */
+  Optional<LayoutQualifiers> consumeLayoutQualifiers() {
     if (!match("layout")) {
-      index = start;
       return {};
     }
 
-    StorageBuffer buffer{};
-
     consumeIdentifier();
-    consumeWhitespace();
 
     if (!expect('(', __LINE__)) {
-      index = start;
       return {};
     }
 
-    if (const auto maybeSet = consumeAttributeValue("set");
-        maybeSet.has_value()) {
-      buffer.set = atoi(maybeSet.value().c_str()); // NOLINT(*-err33-c)
-      consumeWhitespace();
-    } else {
-      index = start;
-      return {};
-    }
+    LayoutQualifiers qualifiers{};
 
-    if (peek() != ',') {
-      index = start;
-      return {};
-    }
+    while (peek() != ')') {
+      const auto name = consumeIdentifier();
 
-    consumeCharacter();
-    consumeWhitespace();
+      Optional<uint32_t> value{};
+      if (accept('=')) {
+        value = integer(consumeIdentifier());
+      }
 
-    if (const auto maybeBinding = consumeAttributeValue("binding");
-        maybeBinding.has_value()) {
-      buffer.binding = atoi(maybeBinding.value().c_str()); // NOLINT(*-err33-c)
-      consumeWhitespace();
-    } else {
-      index = start;
-      return {};
-    }
+      switch (keywords::lookup(name)) {
+      case Keyword::Set:
+        qualifiers.set = value.value_or(0);
+        break;
+      case Keyword::Binding:
+        qualifiers.binding = value.value_or(0);
+        break;
+      case Keyword::PushConstant:
+        qualifiers.pushConstant = true;
+        break;
+      case Keyword::BufferReference:
+        qualifiers.bufferReference = true;
+        break;
+      default:
+        if (name.starts_with("std")) {
+          qualifiers.standard = integer(name.substr(3));
+        }
+        break;
+      }
 
-    if (peek() != ')') {
-      index = start;
-      return {};
+      if (peek() == ')') {
+        break;
+      }
+
+      if (!expect(',', __LINE__)) {
+        return {};
+      }
     }
 
-    consumeCharacter();
-    consumeWhitespace();
+    consumeToken();
 
     if (match("readonly")) {
       consumeIdentifier();
-      consumeWhitespace();
 
-      buffer.readonly = true;
+      qualifiers.readonly = true;
+    }
+
+    return qualifiers;
+  }
+
+  bool consumeLayout(Context &context) {
+    const auto qualifiers = consumeLayoutQualifiers();
+    if (!qualifiers.has_value()) {
+      return false;
     }
 
-    if (!match("buffer")) {
-      index = start;
+    switch (keywords::lookup(consumeIdentifier())) {
+    case Keyword::Buffer:
+      if (qualifiers->bufferReference) {
+        if (auto result = consumeBufferLayout(qualifiers.value());
+            result.has_value()) {
+          context.bufferLayouts.push_back(std::move(result.value()));
+          return true;
+        }
+      } else if (auto result = consumeStorageBuffer(qualifiers.value());
+                 result.has_value()) {
+        context.inputs.emplace_back(ShaderInput::Kind_StorageBuffer,
+                                    result.value());
+        context.storageBuffers.push_back(std::move(result.value()));
+        return true;
+      }
+      return false;
+    case Keyword::Uniform:
+      if (qualifiers->pushConstant) {
+        if (auto result = consumePushConstantsLayout(); result.has_value()) {
+          context.pushConstantsLayout = std::move(result.value());
+          return true;
+        }
+      } else if (auto result = consumeUniform(qualifiers.value());
+                 result.has_value()) {
+        context.inputs.emplace_back(ShaderInput::Kind_Uniform, result.value());
+        context.uniforms.push_back(std::move(result.value()));
+        return true;
+      }
+      return false;
+    default:
+      return false;
+    }
+  }
+
+  Optional<StorageBuffer>
+  consumeStorageBuffer(const LayoutQualifiers &qualifiers) {
+    /*
+     *  layout (set = 2, binding = 0) buffer Hello {
+     *    uint data[];
+     *  };
+     */
+
+    if (!qualifiers.set.has_value() || !qualifiers.binding.has_value()) {
       return {};
     }
 
-    consumeIdentifier();
-    consumeWhitespace();
+    StorageBuffer buffer{allocator};
+    buffer.set = qualifiers.set.value();
+    buffer.binding = qualifiers.binding.value();
+    buffer.readonly = qualifiers.readonly;
 
     buffer.name = consumeIdentifier();
-    consumeWhitespace();
 
     const auto maybeStruct = consumeStruct();
     if (!maybeStruct.has_value()) {
-      index = start;
       return {};
     }
 
-    auto _struct = maybeStruct.value();
-    _struct.name = buffer.name;
-
-    buffer.description = _struct;
+    buffer.description = std::move(maybeStruct.value());
+    buffer.description.name = buffer.name;
 
     return buffer;
   }
 
-  Optional<BufferLayout> consumeBufferLayout() {
+  Optional<BufferLayout>
+  consumeBufferLayout(const LayoutQualifiers &qualifiers) {
     /*
      *  layout (buffer_reference, std430) readonly buffer LightBuffer {
      *    Light lights[];
      *  };
      */
 
-    const auto start = index;
-
-    if (!match("layout")) {
-      index = start;
-      return {};
-    }
-
-    BufferLayout bufferLayout{};
-
-    consumeIdentifier();
-    consumeWhitespace();
-
-    if (!expect('(', __LINE__)) {
-      index = start;
-      return {};
-    }
-
-    consumeWhitespace();
-
-    if (!match("buffer_reference")) {
-      index = start;
-      return {};
-    }
-
-    consumeIdentifier();
-
-    if (peek() == ',') {
-      consumeCharacter();
-      consumeWhitespace();
-
-      if (!match("std")) {
-        index = start;
-        return {};
-      }
-
-      consumeCharacter();
-      consumeCharacter();
-      consumeCharacter();
-
-      bufferLayout.standard =
-          atoi(consumeIdentifier().c_str()); // NOLINT(*-err33-c)
-
-      consumeWhitespace();
-    }
-
-    if (!expect(')', __LINE__)) {
-      index = start;
-      return {};
-    }
-
-    consumeWhitespace();
-
-    if (match("readonly")) {
-      consumeIdentifier();
-
-      bufferLayout.readonly = true;
-    }
-
-    consumeWhitespace();
-
-    if (!match("buffer")) {
-      index = start;
-      return {};
-    }
-
-    consumeIdentifier();
-    consumeWhitespace();
+    BufferLayout bufferLayout{allocator};
+    bufferLayout.standard = qualifiers.standard;
+    bufferLayout.readonly = qualifiers.readonly;
 
     bufferLayout.name = consumeIdentifier();
 
-    consumeWhitespace();
-
     if (!expect('{', __LINE__)) {
-      index = start;
       return {};
     }
 
-    consumeWhitespace();
-
     bufferLayout.typeName = consumeIdentifier();
 
-    consumeWhitespace();
-
     consumeIdentifier();
 
     if (!expect('[', __LINE__) || !expect(']', __LINE__) ||
         !expect(';', __LINE__)) {
-      index = start;
       return {};
     }
 
-    consumeWhitespace();
-
     if (!expect('}', __LINE__)) {
-      index = start;
       return {};
     }
 
@@ -453,51 +397,38 @@ public:
   }
 
   Optional<Struct> consumeStruct() {
-    const auto start = index;
-
     if (!expect('{', __LINE__)) {
       return {};
     }
 
-    Struct _struct{};
-
-    consumeWhitespace();
+    Struct _struct{allocator};
 
     while (peek() != '}') {
-      Struct::Field field{};
+      auto &field = _struct.fields.emplace_back();
       field.type = consumeIdentifier();
-      consumeWhitespace();
-
       field.name = consumeIdentifier();
-      consumeWhitespace();
 
       if (peek() == '[') {
         field.array = true;
 
-        consumeCharacter();
+        consumeToken();
 
         if (!expect(']', __LINE__)) {
-          index = start;
           return {};
         }
       }
 
-      _struct.fields.push_back(field);
-
       if (!expect(';', __LINE__)) {
-        index = start;
         return {};
       }
-
-      consumeWhitespace();
     }
 
-    consumeCharacter();
+    consumeToken();
 
     return _struct;
   }
 
-  Optional<Uniform> consumeUniform() {
+  Optional<Uniform> consumeUniform(const LayoutQualifiers &qualifiers) {
     /*
      layout (set = 1, binding = 0) uniform sampler2D textures[];
      */
@@ -510,114 +441,27 @@ public:
         } global;
      */
 
-    const auto start = index;
-
-    Uniform uniform{};
-
-    if (!match("layout")) {
-      index = start;
-      return {};
-    }
-
-    consumeIdentifier();
-
-    {
-      consumeWhitespace();
-
-      if (!expect('(', __LINE__)) {
-        index = start;
-        return {};
-      }
-
-      consumeWhitespace();
-
-      {
-        if (match("push_constant")) {
-          consumeIdentifier();
-          consumeWhitespace();
-
-          uniform.value.kind = UniformValue::Kind_PushConstants;
-        } else if (match("set")) {
-          consumeIdentifier();
-          consumeWhitespace();
-
-          if (!expect('=', __LINE__)) {
-            index = start;
-            return {};
-          }
-
-          consumeWhitespace();
-
-          uniform.set = atoi(consumeIdentifier().c_str()); // NOLINT(*-err33-c)
-
-          consumeWhitespace();
-          if (!expect(',', __LINE__)) {
-            index = start;
-
-            return {};
-          }
-
-          consumeWhitespace();
-
-          {
-            if (!match("binding")) {
-              index = start;
-              return {};
-            }
-
-            consumeIdentifier();
-            consumeWhitespace();
-
-            if (!expect('=', __LINE__)) {
-              index = start;
-              return {};
-            }
-
-            consumeWhitespace();
-
-            uniform.binding =
-                atoi(consumeIdentifier().c_str()); // NOLINT(*-err33-c)
-
-            consumeWhitespace();
-          }
-        } else {
-          index = start;
-          return {};
-        }
-      }
-
-      if (!expect(')', __LINE__)) {
-        index = start;
-        return {};
-      }
-    }
-
-    consumeWhitespace();
-
-    if (!match("uniform")) {
-      index = start;
+    if (!qualifiers.set.has_value() || !qualifiers.binding.has_value()) {
       return {};
     }
 
-    consumeIdentifier();
-    consumeWhitespace();
+    Uniform uniform{allocator};
+    uniform.set = qualifiers.set.value();
+    uniform.binding = qualifiers.binding.value();
 
-    std::string typeName = consumeIdentifier();
-    consumeWhitespace();
+    const auto typeName = consumeIdentifier();
 
     if (peek() != '{') {
       uniform.accessor = consumeIdentifier();
 
-      if (expect('[', __LINE__)) {
+      if (accept('[')) {
         //  it's an array
 
         if (peek() != ']') {
-          uniform.value.arrayLength =
-              atoi(consumeIdentifier().c_str()); // NOLINT(*-err33-c)
+          uniform.value.arrayLength = integer(consumeIdentifier());
         }
 
         if (!expect(']', __LINE__)) {
-          index = start;
           return {};
         }
       }
@@ -625,7 +469,7 @@ public:
       //  @todo: parse type correctly
       if (typeName == "sampler2D") {
         uniform.value.kind = UniformValue::Kind_Sampler2D;
-      } else if (uniform.value.kind == UniformValue::Kind_Unknown) {
+      } else {
         uniform.value.kind = UniformValue::Kind_Vec4;
       }
 
@@ -633,147 +477,66 @@ public:
     }
 
     {
-      if (uniform.value.kind == UniformValue::Kind_Unknown) {
-        uniform.value.kind = UniformValue::Kind_Struct;
-      }
+      uniform.value.kind = UniformValue::Kind_Struct;
 
       if (!expect('{', __LINE__)) {
-        index = start;
         return {};
       }
 
-      consumeWhitespace();
-
       while (peek() != '}') {
-        Struct::Field field{};
+        auto &field = uniform.value.struct_.fields.emplace_back();
         field.type = consumeIdentifier();
-        consumeWhitespace();
-
         field.name = consumeIdentifier();
-        consumeWhitespace();
-
-        uniform.value.struct_.fields.push_back(field);
 
         if (!expect(';', __LINE__)) {
-          index = start;
           return {};
         }
-
-        consumeWhitespace();
       }
 
-      consumeCharacter();
+      consumeToken();
     }
 
-    consumeWhitespace();
-
     uniform.accessor = consumeIdentifier();
 
-    consumeWhitespace();
-
     if (!expect(';', __LINE__)) {
-      index = start;
       return {};
     }
 
-    consumeWhitespace();
-
     return uniform;
   }
 
   Optional<PushConstantsLayout> consumePushConstantsLayout() {
-    const auto start = index;
-
-    PushConstantsLayout pushConstantsLayout{};
-
-    if (!match("layout")) {
-      index = start;
-      return {};
-    }
-
-    consumeIdentifier();
-    consumeWhitespace();
-
-    if (!expect('(', __LINE__)) {
-      index = start;
-      return {};
-    }
-
-    consumeWhitespace();
-
-    if (match("push_constant")) {
-      consumeIdentifier();
-      consumeWhitespace();
-    } else {
-      index = start;
-      return {};
-    }
-
-    if (!expect(')', __LINE__)) {
-      index = start;
-      return {};
-    }
-
-    consumeWhitespace();
-
-    if (!match("uniform")) {
-      index = start;
-      return {};
-    }
-
-    consumeIdentifier();
-    consumeWhitespace();
+    PushConstantsLayout pushConstantsLayout{allocator};
 
     //  uniform type name, useless
     consumeIdentifier();
-    consumeWhitespace();
 
     const auto _struct = consumeStruct();
     if (!_struct.has_value()) {
-      index = start;
       return {};
     }
 
-    pushConstantsLayout.fields = _struct.value().fields;
+    pushConstantsLayout.fields = std::move(_struct.value().fields);
 
-    consumeWhitespace();
     pushConstantsLayout.name = consumeIdentifier();
-    consumeWhitespace();
 
     if (!expect(';', __LINE__)) {
-      index = start;
       return {};
     }
 
     return pushConstantsLayout;
   }
 
-  Optional<std::string> consumeDirective() {
-    if (peek() != '#') {
+  Optional<std::string_view> consumeDirective() {
+    if (lexer.peek().kind != Token::Kind::Directive) {
       return {};
     }
 
-    consumeCharacter();
-    return consumeUntil("\n");
+    return consumeToken().text;
   }
 
-  std::string consumeUntil(const std::string &expected) {
-    const auto start = index;
-
-    while (index < input.size()) {
-      size_t e = 0;
-      while (e < expected.size() && expected[e] == input[index + e]) {
-        e++;
-      }
-
-      if (e >= expected.size()) {
-        return input.substr(start, index - start);
-      }
-
-      index++;
-    }
-
-    return input.substr(start, index - start);
+  std::string_view consumeUntil(const std::string_view expected) {
+    return lexer.until(expected);
   }
 
   Optional<Varying> consumeVarying() {
@@ -782,15 +545,11 @@ public:
     }
 
     consumeIdentifier();
-    consumeWhitespace();
 
-    Varying varying{};
+    Varying varying{allocator};
 
     varying.precision = consumeIdentifier();
-    consumeWhitespace();
-
     varying.type = consumeIdentifier();
-    consumeWhitespace();
 
     if (peek() == ';') {
       //  @note: we don't have precision
@@ -798,66 +557,51 @@ public:
       varying.type = varying.precision;
       varying.precision = EmptyString;
 
-      return {varying};
+      return varying;
     }
 
     varying.name = consumeIdentifier();
-    consumeWhitespace();
 
     if (!expect(';', __LINE__)) {
       return {};
     }
 
-    return {varying};
+    return varying;
   }
 
-  Optional<int> consumeVersion() {
-    const auto start = index;
-
-    int version = 0;
-
-    if (!match("#version")) {
+  [[nodiscard]] static Optional<int> version(const std::string_view directive) {
+    if (!directive.starts_with("version")) {
       return {};
     }
 
-    consumeCharacter();
-    consumeIdentifier();
-    consumeWhitespace();
-
-    version = atoi(consumeIdentifier().c_str()); // NOLINT(*-err33-c)
-    if (version == 0) {
-      index = start;
-
-      return {};
+    Lexer arguments{directive.substr(7)};
+    if (const auto version = static_cast<int>(integer(arguments.next().text));
+        version != 0) {
+      return {version};
     }
 
-    consumeWhitespace();
-
-    return {version};
+    return {};
   }
 
-  std::string consumeWhile(const std::function<bool()> &predicate) {
-    const auto start = index;
+  [[nodiscard]] bool done() {
+    lexer.skipTrivia();
 
-    while (index < input.size() && predicate()) {
-      index++;
-    }
-
-    return input.substr(start, index - start);
+    return lexer.done();
   }
 
-  void consumeWhitespace() {
-    while (whitespace(index)) {
-      index++;
+  [[nodiscard]] bool accept(const char expected) {
+    const auto start = lexer.offset();
+    if (consumeToken().is(expected)) {
+      return true;
     }
-  }
 
-  [[nodiscard]] bool done() const { return index >= input.size(); }
+    lexer.rewind(start);
 
-  [[nodiscard]] bool expect(const char expected, size_t line) {
-    if (input[index] == expected) {
-      index++;
+    return false;
+  }
 
+  [[nodiscard]] bool expect(const char expected, size_t line) {
+    if (accept(expected)) {
       return true;
     }
 
@@ -866,68 +610,166 @@ public:
     return false;
   }
 
-  [[nodiscard]] bool match(const std::string &expected) const {
-    const auto start = index;
+  [[nodiscard]] bool match(const std::string_view expected) {
+    return lexer.peek().is(expected);
+  }
 
-    size_t e = 0;
-    while (start + e < input.size() && e < expected.size()) {
-      if (expected[e] == input[start + e]) {
-        e++;
-      } else {
-        return false;
-      }
+  struct Include {
+    std::string_view file;
+    bool relative;
+  };
 
-      if (e >= expected.size()) {
-        return true;
-      }
+  //  @note: `include "file"` or `include <file>`
+  [[nodiscard]] static Optional<Include>
+  include(const std::string_view directive) {
+    if (!directive.starts_with("include")) {
+      return {};
     }
 
-    return false;
-  }
+    auto rest = directive.substr(std::string_view{"include"}.size());
+    rest.remove_prefix(std::min(rest.find_first_not_of(" \t"), rest.size()));
 
-  void parseInclude(const std::string &file, Context &parentContext) {
-    const auto includedSource =
-        includer.GetInclude(file.c_str(), shaderc_include_type_relative,
-                            (char *)inputPath.c_str(), 3);
+    if (rest.size() < 2 || (rest.front() != '"' && rest.front() != '<')) {
+      return {};
+    }
 
-    Parser parser{includedSource->content, file};
-    if (auto parseResult = parser.parse(); parseResult.has_value()) {
-      Context &context = parseResult.value();
+    const char close = rest.front() == '"' ? '"' : '>';
+    const auto end = rest.find(close, 1);
+    if (end == std::string_view::npos) {
+      return {};
+    }
 
-      for (auto &bufferLayout : context.bufferLayouts) {
-        parentContext.bufferLayouts.push_back(bufferLayout);
-      }
+    return Include{rest.substr(1, end - 1), close == '"'};
+  }
 
-      for (auto &directive : context.directives) {
-        parentContext.directives.push_back(directive);
+  /*
+   *  Links the include's Context into the parent. It is parsed on a cache
+   *  miss only, into an arena of its own so it can be shared with every
+   *  other file including it.
+   */
+  void parseInclude(const Include &include, Context &parentContext) {
+    const auto *source =
+        resolver->include(include.file, inputPath, include.relative);
+    if (!source) {
+      error("[include] {} tried to include {}, but file not found.",
+            inputPath.c_str(), include.file);
+      incomplete = true;
+      return;
+    }
+
+    const auto key = IncludeCache::key(*source);
+
+    if (cyclic(key.path)) {
+      incomplete = true;
+      return;
+    }
+
+    auto included = includeCache.find(key, *resolver);
+    if (included) {
+      //  @note: a cached include may have been parsed from another file and
+      //  reach back into this include stack
+      bool cycle = false;
+      included->visit([&](const Context &context) {
+        cycle = cycle || cyclic(context.path);
+      });
+
+      if (cycle) {
+        incomplete = true;
+        return;
       }
+    } else {
+      auto owned = std::make_shared<OwnedContext>();
 
-      for (auto &function : context.functions) {
-        parentContext.functions.push_back(function);
-      }
+      Parser parser{source->content(), source->path, &owned->arena, resolver,
+                    includeCache};
+      parser.parent = this;
+      parser.canonicalPath = key.path;
 
-      for (auto &input : context.inputs) {
-        parentContext.inputs.push_back(input);
+      auto parseResult = parser.parse();
+      if (!parseResult.has_value()) {
+        incomplete = true;
+        return;
       }
 
-      for (auto &buffer : context.storageBuffers) {
-        parentContext.storageBuffers.push_back(buffer);
-      }
+      owned->context.emplace(std::move(parseResult.value()));
+      owned->context->hash = key.hash;
+
+      const Context *context = &owned->context.value();
+      included = std::shared_ptr<const Context>{std::move(owned), context};
 
-      for (auto &uniform : context.uniforms) {
-        parentContext.uniforms.push_back(uniform);
+      if (parser.incomplete) {
+        incomplete = true;
+      } else {
+        included = includeCache.insert(key, std::move(included));
       }
+    }
+
+    //  @note: a second #include of the same file adds nothing, the emitted
+    //  directive is skipped by the includer too
+    if (std::ranges::find(parentContext.includes, included) ==
+        parentContext.includes.end()) {
+      parentContext.includes.push_back(std::move(included));
+    }
+  }
 
-      for (auto &varying : context.varyings) {
-        parentContext.varyings.push_back(varying);
+  [[nodiscard]] bool cyclic(const std::string_view path) const {
+    bool found = false;
+    for (const Parser *p = this; p && !found; p = p->parent) {
+      found = p->canonicalPath == path;
+    }
+
+    if (!found) {
+      return false;
+    }
+
+    std::string chain{path};
+    for (const Parser *p = this; p; p = p->parent) {
+      chain = fmt::format("{} -> {}", p->canonicalPath, chain);
+      if (p->canonicalPath == path) {
+        break;
       }
     }
 
-    includer.ReleaseInclude(includedSource);
+    error("[include] cycle: {}", chain);
+    return true;
   }
 
+  void parseDirective(const std::string_view directive, Context &context) {
+    if (const auto result = version(directive); result.has_value()) {
+      context.version = result.value();
+    } else if (const auto included = include(directive);
+               included.has_value()) {
+      //  @note: repeated verbatim, the file is already in
+      if (std::ranges::find(context.directives, directive) !=
+          context.directives.end()) {
+        return;
+      }
+
+      parseInclude(included.value(), context);
+      context.directives.emplace_back(directive);
+    } else if (directive == "dawn_inline_frag") {
+      auto inlinedCode = consumeUntil("#dawn_inline_frag");
+      context.inlinedFragmentCode.emplace_back(inlinedCode);
+      consumeDirective();
+    } else {
+      context.directives.emplace_back(directive);
+    }
+  }
+
+  /*
+   *  Dispatches on the leading token of every top-level declaration, so each
+   *  one is parsed exactly once. Anything that does not parse is skipped up to
+   *  the end of its line.
+   */
   Optional<Context> parse() {
-    Context context{};
+    Context context{allocator};
+
+    if (canonicalPath.empty() && !inputPath.empty()) {
+      canonicalPath = resolver->identity(inputPath);
+    }
+
+    context.path = parent ? std::string_view{canonicalPath}
+                          : std::string_view{inputPath.native()};
 
     context.config.blend.value = config::ColorBlend::Value::Disabled;
     context.config.depthTest.value = config::DepthTest::Value::Enabled;
@@ -943,128 +785,107 @@ public:
     context.config.depthAttachment.enabled = true;
 
     while (!done()) {
-      consumeWhitespace();
-
-      if (auto result = consumeVersion(); result.has_value()) {
-        context.version = result.value_or(450);
-        continue;
-      }
+      const auto token = lexer.peek();
 
-      if (auto result = consumePipelineConfigurationVariable();
-          result.has_value()) {
-
-        std::visit(
-            [&context](const auto &value) {
-              using T = std::decay_t<decltype(value)>;
-
-              if constexpr (std::is_same_v<T, config::ColorBlend>) {
-                context.config.blend = value;
-              } else if constexpr (std::is_same_v<T, config::DepthTest>) {
-                context.config.depthTest = value;
-              } else if constexpr (std::is_same_v<T, config::DepthWrite>) {
-                context.config.depthWrite = value;
-              } else if constexpr (std::is_same_v<T, config::DepthOp>) {
-                context.config.depthOp = value;
-              } else if constexpr (std::is_same_v<T, config::Polygon>) {
-                context.config.polygon = value;
-              } else if constexpr (std::is_same_v<T, config::Cull>) {
-                context.config.cull = value;
-              } else if constexpr (std::is_same_v<T, config::FrontFace>) {
-                context.config.front_face = value;
-              } else if constexpr (std::is_same_v<T, config::Topology>) {
-                context.config.topology = value;
-              } else if constexpr (std::is_same_v<T, config::Multisampling>) {
-                context.config.multisampling = value;
-              } else if constexpr (std::is_same_v<
-                                       T, config::ColorAttachmentCount>) {
-                context.config.colorAttachmentCount = value;
-              } else if constexpr (std::is_same_v<T, config::DepthAttachment>) {
-                context.config.depthAttachment = value;
-              }
-            },
-            result.value());
+      if (token.kind == Token::Kind::Directive) {
+        consumeToken();
+        parseDirective(token.text, context);
         continue;
       }
 
-      if (auto result = consumeConst(); result.has_value()) {
-        continue;
-      }
-
-      if (auto result = consumeStorageBuffer(); result.has_value()) {
-        context.storageBuffers.push_back(result.value());
-        context.inputs.emplace_back(ShaderInput::Kind_StorageBuffer,
-                                    result.value());
-        continue;
-      }
-
-      if (auto result = consumeBufferLayout(); result.has_value()) {
-        context.bufferLayouts.push_back(result.value());
-        continue;
-      }
+      bool parsed = false;
 
-      if (auto result = consumePushConstantsLayout(); result.has_value()) {
-        context.pushConstantsLayout = result.value();
-        continue;
-      }
-
-      if (auto result = consumeUniform(); result.has_value()) {
-        context.uniforms.push_back(result.value());
-        context.inputs.emplace_back(ShaderInput::Kind_Uniform, result.value());
-        continue;
-      }
-
-      if (auto result = consumeDirective(); result.has_value()) {
-        if (const auto &directive = result.value();
-            directive.starts_with("include")) {
-          auto file = directive.substr(9, directive.size() - 1 - 9);
-          parseInclude(file, context);
-          context.directives.push_back(directive);
-        } else if (directive == "dawn_inline_frag") {
-          auto inlinedCode = consumeUntil("#dawn_inline_frag");
-          context.inlinedFragmentCode.push_back(inlinedCode);
-          consumeDirective();
-        } else if (directive != "dawn_inline_frag") {
-          context.directives.push_back(directive);
+      if (token.kind == Token::Kind::Identifier) {
+        switch (const auto keyword = keywords::lookup(token.text)) {
+        case Keyword::Layout:
+          parsed = consumeLayout(context);
+          break;
+        case Keyword::Const:
+          parsed = consumeConst().has_value();
+          break;
+        case Keyword::Varying:
+          if (auto result = consumeVarying(); result.has_value()) {
+            context.varyings.push_back(std::move(result.value()));
+            parsed = true;
+          }
+          break;
+        default:
+          if (keywords::configuration(keyword)) {
+            if (auto result = consumePipelineConfigurationVariable(keyword);
+                result.has_value()) {
+              apply(context.config, result.value());
+              parsed = true;
+            }
+          } else if (auto result = consumeFunction(); result.has_value()) {
+            context.functions.push_back(std::move(result.value()));
+            parsed = true;
+          }
+          break;
         }
-
-        continue;
       }
 
-      if (match("//")) {
-        consumeUntil("\n");
-        consumeWhitespace();
-        continue;
-      }
-
-      if (auto result = consumeVarying(); result.has_value()) {
-        context.varyings.push_back(result.value());
-        continue;
-      }
-
-      if (auto result = consumeFunction(); result.has_value()) {
-        context.functions.push_back(result.value());
-        continue;
+      if (!parsed) {
+        lexer.rewind(token.offset);
+        lexer.skipLine();
       }
+    }
 
-      consumeUntil("\n");
-      consumeWhitespace();
+    if (!parent) {
+      context.link();
     }
 
-    return {context};
+    return context;
+  }
+
+  static void apply(PipelineConfiguration &config,
+                    const config::ConfigValue &configValue) {
+    std::visit(
+        [&config](const auto &value) {
+          using T = std::decay_t<decltype(value)>;
+
+          if constexpr (std::is_same_v<T, config::ColorBlend>) {
+            config.blend = value;
+          } else if constexpr (std::is_same_v<T, config::DepthTest>) {
+            config.depthTest = value;
+          } else if constexpr (std::is_same_v<T, config::DepthWrite>) {
+            config.depthWrite = value;
+          } else if constexpr (std::is_same_v<T, config::DepthOp>) {
+            config.depthOp = value;
+          } else if constexpr (std::is_same_v<T, config::Polygon>) {
+            config.polygon = value;
+          } else if constexpr (std::is_same_v<T, config::Cull>) {
+            config.cull = value;
+          } else if constexpr (std::is_same_v<T, config::FrontFace>) {
+            config.front_face = value;
+          } else if constexpr (std::is_same_v<T, config::Topology>) {
+            config.topology = value;
+          } else if constexpr (std::is_same_v<T, config::Multisampling>) {
+            config.multisampling = value;
+          } else if constexpr (std::is_same_v<T,
+                                              config::ColorAttachmentCount>) {
+            config.colorAttachmentCount = value;
+          } else if constexpr (std::is_same_v<T, config::DepthAttachment>) {
+            config.depthAttachment = value;
+          }
+        },
+        configValue);
   }
 
   void printError(const char expected, size_t line) {
+    const auto index = lexer.peek().offset;
+    const auto source = lexer.source();
+
     fmt::println("[{}] {}\n at line {} (in the cpp file)", index,
-                 input.substr(0, index), line);
+                 source.substr(0, index), line);
 
     error("expected character '{}' at index {}, got '{}'", expected, index,
-          input[index]);
+          lexer.at(index));
   }
 
-  [[nodiscard]] char peek() const { return input[index]; }
+  [[nodiscard]] char peek() {
+    const auto token = lexer.peek();
 
-  [[nodiscard]] bool whitespace(const size_t i) const {
-    return input[i] == '\t' || input[i] == '\n' || std::isspace(input[i]);
+    return token.end() ? '\0' : token.text[0];
   }
 };
 
@@ -0,0 +1,247 @@
+#pragma once
+
+#include <ryuko/core.hpp>
+
+namespace ryuko {
+
+//  how a compilation runs its independent parts, e.g. the two stages
+enum class Execution {
+  Serial,
+  Parallel,
+};
+
+/*
+ *  Set from any thread to abandon work that was started. Long running work
+ *  checks it between its phases and gives up with an empty result.
+ */
+class Cancellation final {
+  std::atomic<bool> flag = false;
+
+public:
+  void cancel() { flag.store(true, std::memory_order_relaxed); }
+
+  [[nodiscard]] bool cancelled() const {
+    return flag.load(std::memory_order_relaxed);
+  }
+};
+
+[[maybe_unused, nodiscard]] static bool
+cancelled(const Cancellation *cancellation) {
+  return cancellation && cancellation->cancelled();
+}
+
+/*
+ *  A fixed set of threads with a task deque each. Workers push the tasks they
+ *  submit onto their own deque and take the newest one back first, tasks
+ *  submitted from outside go to a shared queue. An idle worker takes from
+ *  the shared queue, then steals the oldest task of another worker, so a
+ *  batch whose jobs fan out keeps every thread busy.
+ *
+ *  A thread waiting for a task through wait() runs it itself if no thread
+ *  has started it yet. A worker waiting for a task that did start runs
+ *  queued tasks meanwhile, so tasks may wait on tasks they submitted without
+ *  starving the pool. Any other thread blocks: it never picks up unrelated
+ *  work, which would delay its own.
+ */
+class WorkerPool final {
+public:
+  //  a submitted task, to wait() for
+  template <typename R> class Task final {
+    friend class WorkerPool;
+
+    struct State {
+      std::packaged_task<R()> task;
+      std::atomic<bool> started = false;
+
+    public:
+      //  @note: runs the task unless a thread already did
+      void run() {
+        if (!started.exchange(true, std::memory_order_acq_rel)) {
+          task();
+        }
+      }
+    };
+
+    std::shared_ptr<State> state;
+    std::future<R> future;
+
+  public:
+    [[nodiscard]] bool valid() const { return future.valid(); }
+  };
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  //  @note: one per worker, the last one is the shared queue. Complete
+  //  before the first worker starts, workers only read it.
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> workers;
+
+  std::mutex mutex;
+  std::condition_variable available;
+  size_t pending = 0;
+  bool stopping = false;
+
+  static inline thread_local const WorkerPool *current = nullptr;
+  static inline thread_local size_t currentIndex = 0;
+
+public:
+  explicit WorkerPool(const size_t size = defaultSize()) {
+    queues.reserve(size + 1);
+    for (size_t i = 0; i <= size; i++) {
+      queues.push_back(std::make_unique<Queue>());
+    }
+
+    workers.reserve(size);
+    for (size_t i = 0; i < size; i++) {
+      workers.emplace_back([this, i] { work(i); });
+    }
+  }
+
+  ~WorkerPool() {
+    {
+      std::lock_guard lock{mutex};
+      stopping = true;
+    }
+
+    available.notify_all();
+    for (auto &worker : workers) {
+      worker.join();
+    }
+  }
+
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+public:
+  [[nodiscard]] static WorkerPool &shared() {
+    static WorkerPool pool;
+    return pool;
+  }
+
+  [[nodiscard]] static size_t defaultSize() {
+    return std::max(2u, std::thread::hardware_concurrency());
+  }
+
+  template <typename F, typename R = std::invoke_result_t<F>>
+  [[nodiscard]] Task<R> submit(F &&task) {
+    //  @note: std::function needs a copyable target
+    Task<R> submitted;
+    submitted.state = std::make_shared<typename Task<R>::State>(
+        std::packaged_task<R()>{std::forward<F>(task)});
+    submitted.future = submitted.state->task.get_future();
+
+    //  @note: counted and queued under one lock, so take() never counts it
+    //  first and an idle worker never sees it counted but not yet queued.
+    //  take() never holds a queue's lock while it locks the pool's.
+    auto &queue = *queues[own()];
+    {
+      std::lock_guard lock{mutex};
+      pending++;
+
+      std::lock_guard queueLock{queue.mutex};
+      queue.tasks.emplace_back([state = submitted.state] { state->run(); });
+    }
+
+    available.notify_one();
+    return submitted;
+  }
+
+  template <typename T> T wait(Task<T> &task) {
+    using namespace std::chrono_literals;
+
+    //  @note: its queue entry is left behind and skipped when taken
+    task.state->run();
+
+    //  @note: the task may be running elsewhere and waiting on queued work
+    if (current == this) {
+      while (task.future.wait_for(0s) != std::future_status::ready) {
+        if (!runOne(own())) {
+          task.future.wait_for(100us);
+        }
+      }
+    }
+
+    return task.future.get();
+  }
+
+  [[nodiscard]] size_t size() const { return queues.size() - 1; }
+
+private:
+  //  the deque tasks submitted from this thread go to
+  [[nodiscard]] size_t own() const {
+    return current == this ? currentIndex : size();
+  }
+
+  std::function<void()> take(const size_t index) {
+    const auto shared = size();
+
+    const auto pop = [](Queue &queue, const bool newest) {
+      std::function<void()> task;
+
+      std::lock_guard lock{queue.mutex};
+      if (!queue.tasks.empty()) {
+        if (newest) {
+          task = std::move(queue.tasks.back());
+          queue.tasks.pop_back();
+        } else {
+          task = std::move(queue.tasks.front());
+          queue.tasks.pop_front();
+        }
+      }
+
+      return task;
+    };
+
+    auto task = pop(*queues[index], index != shared);
+    if (!task && index != shared) {
+      task = pop(*queues[shared], false);
+    }
+
+    for (size_t i = 1; !task && i < queues.size(); i++) {
+      const auto victim = (index + i) % queues.size();
+      if (victim != shared) {
+        task = pop(*queues[victim], false);
+      }
+    }
+
+    if (task) {
+      std::lock_guard lock{mutex};
+      pending--;
+    }
+
+    return task;
+  }
+
+  bool runOne(const size_t index) {
+    auto task = take(index);
+    if (!task) {
+      return false;
+    }
+
+    task();
+    return true;
+  }
+
+  void work(const size_t index) {
+    current = this;
+    currentIndex = index;
+
+    while (true) {
+      if (runOne(index)) {
+        continue;
+      }
+
+      std::unique_lock lock{mutex};
+      available.wait(lock, [this] { return stopping || pending > 0; });
+      if (stopping && pending == 0) {
+        return;
+      }
+    }
+  }
+};
+
+} // namespace ryuko
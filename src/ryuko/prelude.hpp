@@ -0,0 +1,62 @@
+#pragma once
+
+#include <ryuko/core.hpp>
+
+namespace ryuko {
+
+/*
+ *  The lines both stages of a program start with: version, precision and
+ *  extension lines, the PI constant and the file's directives. Written once
+ *  per Context, straight into the first stage's output, the other stage
+ *  copies it from there.
+ */
+struct Prelude {
+  static constexpr std::string_view extensions[]{
+      "precision mediump int;",
+      "precision highp float;",
+      "#extension GL_EXT_buffer_reference: require",
+      // "#extension GL_EXT_debug_printf: require",
+      "const float PI = 3.14159265359;",
+  };
+
+public:
+  Prelude() = delete;
+
+public:
+  //  @note: appends to `output`, returns where the prelude starts
+  static size_t write(const Context &context, std::string &output) {
+    const auto begin = output.size();
+    output.reserve(begin + size(context));
+
+    fmt::format_to(std::back_inserter(output), "#version {}\n\n",
+                   context.version);
+
+    for (const auto &extension : extensions) {
+      output += extension;
+      output += '\n';
+    }
+
+    for (const auto &directive : context.directives) {
+      output += '#';
+      output += directive;
+      output += '\n';
+    }
+
+    return begin;
+  }
+
+  [[nodiscard]] static size_t size(const Context &context) {
+    size_t size = 32;
+    for (const auto &extension : extensions) {
+      size += extension.size() + 1;
+    }
+
+    for (const auto &directive : context.directives) {
+      size += directive.size() + 2;
+    }
+
+    return size;
+  }
+};
+
+} // namespace ryuko
@@ -2,38 +2,52 @@
 
 #include <ryuko/core.hpp>
 #include <ryuko/emitter.hpp>
+#include <ryuko/includer.hpp>
 #include <ryuko/parser.hpp>
 #include <ryuko/transpiler.hpp>
 
 namespace ryuko {
 
+//  @note: a good fit for a single shader, the arena grows past it if needed
+static constexpr size_t ArenaInitialSize = 64 * 1024;
+
+/*
+ *  @note: context allocates from `resource`, so it must not outlive it
+ */
 struct ProcessOutput final {
   Context context;
   Emitter::Output output;
 };
 
+/*
+ *  Processes a shader held in memory, `path` is the name it is reported by
+ *  and the file relative includes are resolved against; nothing is read for
+ *  the shader itself.
+ *
+ *  @note: context points into `source`, which must outlive it
+ */
 [[maybe_unused]]
-static Optional<ProcessOutput> process(const std::filesystem::path &path) {
-  std::ifstream file(path, std::ios::binary);
-  if (!file.is_open()) {
-    error("failed to open file {}", path.c_str());
-
-    return {};
-  }
-
-  std::stringstream buffer;
-  buffer << file.rdbuf();
-  file.close();
-
-  Parser parser{buffer.str(), path};
+static Optional<ProcessOutput>
+process(const std::string_view source, const std::filesystem::path &path,
+        std::pmr::memory_resource *resource = std::pmr::get_default_resource(),
+        const std::shared_ptr<IncludeResolver> &resolver =
+            std::make_shared<IncludeResolver>(),
+        const Execution execution = Execution::Serial,
+        const Cancellation *cancellation = nullptr) {
+  Parser parser{source, path, resource, resolver};
   if (auto parseResult = parser.parse(); parseResult.has_value()) {
     Context &context = parseResult.value();
+    if (cancelled(cancellation)) {
+      debug("cancelled after parsing: {}", path.c_str());
+      return {};
+    }
 
     Transpiler transpiler{context.functions, context.varyings};
     transpiler.setReturnValues();
 
-    if (auto emitResult = Emitter::program(context); emitResult.has_value()) {
-      return ProcessOutput{std::move(context), emitResult.value()};
+    if (auto emitResult = Emitter::program(context, execution);
+        emitResult.has_value()) {
+      return ProcessOutput{std::move(context), std::move(emitResult.value())};
     }
 
     error("failed to emit shader: {}", path.c_str());
@@ -44,4 +58,72 @@ static Optional<ProcessOutput> process(const std::filesystem::path &path) {
   return {};
 }
 
+[[maybe_unused]]
+static Optional<ProcessOutput>
+process(const std::filesystem::path &path,
+        std::pmr::memory_resource *resource = std::pmr::get_default_resource(),
+        const std::shared_ptr<IncludeResolver> &resolver =
+            std::make_shared<IncludeResolver>(),
+        const Execution execution = Execution::Serial,
+        const Cancellation *cancellation = nullptr) {
+  const auto *file = resolver->load(path);
+  if (!file) {
+    error("failed to open file {}", path.c_str());
+
+    return {};
+  }
+
+  return process(file->content(), path, resource, resolver, execution,
+                 cancellation);
+}
+
+/*
+ *  Fills in what the pipeline needs to know about the shader besides its
+ *  code, returns the files it includes. For the sinks of transpilation and
+ *  compilation alike.
+ */
+template <typename Sink>
+static std::vector<std::string> reflect(const Context &context, Sink &sink) {
+  //  @note: element copies allocate from the default resource, out of the arena
+  sink.storageBuffers.clear();
+  sink.inputs.clear();
+  sink.uniforms.clear();
+  std::vector<std::string> includes;
+  context.visit([&sink, &includes, &context](const Context &visible) {
+    if (&visible != &context) {
+      includes.emplace_back(visible.path);
+    }
+
+    sink.storageBuffers.insert(sink.storageBuffers.end(),
+                               visible.storageBuffers.begin(),
+                               visible.storageBuffers.end());
+    sink.inputs.insert(sink.inputs.end(), visible.inputs.begin(),
+                       visible.inputs.end());
+    sink.uniforms.insert(sink.uniforms.end(), visible.uniforms.begin(),
+                         visible.uniforms.end());
+  });
+  sink.config = context.config;
+
+  //  @temp(v2f): generate vertex input struct
+  {
+    std::vector<Varying> vertexInputs;
+    std::vector<Varying> varyings;
+    std::vector<Varying> fragmentOutputs;
+
+    for (auto &varying : context.varyings) {
+      if (varying.vertexInput) {
+        vertexInputs.push_back(varying);
+      } else if (varying.fragmentOutput) {
+        fragmentOutputs.push_back(varying);
+      } else {
+        varyings.push_back(varying);
+      }
+    }
+
+    sink.vertexInputs = vertexInputs;
+  }
+
+  return includes;
+}
+
 } // namespace ryuko
\ No newline at end of file
@@ -0,0 +1,331 @@
+#pragma once
+
+#include <ryuko/compile.hpp>
+#include <ryuko/pool.hpp>
+
+namespace ryuko::compilation {
+
+/*
+ *  Compiles shaders in priority order, for loads that queue many shaders of
+ *  which a few are needed first. The highest priority job is picked each time
+ *  a runner frees up, so priorities may change while jobs wait. At most one
+ *  runner per pool thread is active.
+ *
+ *  A shader submitted while an identical job (same file, same profile) is
+ *  still queued joins that job, and the tickets share its Sink. A cancelled
+ *  job is dropped if it has not started yet, otherwise it stops at the next
+ *  phase boundary (parsed, emitted). A job is cancelled once every ticket
+ *  on it is.
+ *
+ *  @note: wait for or cancel every ticket before destroying the queue
+ */
+class CompileQueue final {
+public:
+  using MakeSink = std::function<std::unique_ptr<Sink>()>;
+
+  enum class State {
+    Queued,
+    Running,
+    Done,
+    Cancelled,
+  };
+
+private:
+  struct Job {
+    std::filesystem::path path;
+    std::string key;
+    Profile profile;
+    std::shared_ptr<IncludeResolver> resolver;
+
+    int priority;
+    size_t sequence;
+    size_t tickets = 1;
+    State state = State::Queued;
+    Cancellation cancellation;
+
+    std::shared_ptr<Sink> sink;
+    Optional<Output> output;
+  };
+
+public:
+  class Ticket final {
+    friend class CompileQueue;
+
+    CompileQueue *queue = nullptr;
+    std::shared_ptr<Job> job;
+    bool dropped = false;
+
+    Ticket(CompileQueue &queue, std::shared_ptr<Job> job)
+        : queue(&queue), job(std::move(job)) {}
+
+  public:
+    Ticket() = default;
+
+    //  @note: the ticket moved from is left invalid, as if cancelled
+    Ticket(Ticket &&other) noexcept
+        : queue(std::exchange(other.queue, nullptr)),
+          job(std::move(other.job)),
+          dropped(std::exchange(other.dropped, true)) {}
+
+    //  @note: gives up on the job this ticket held, as cancel() does
+    Ticket &operator=(Ticket &&other) noexcept {
+      if (this != &other) {
+        cancel();
+
+        queue = std::exchange(other.queue, nullptr);
+        job = std::move(other.job);
+        dropped = std::exchange(other.dropped, true);
+      }
+
+      return *this;
+    }
+
+  public:
+    //  @note: an invalid ticket reads as cancelled and ignores the rest
+    [[nodiscard]] bool valid() const { return job != nullptr; }
+
+    [[nodiscard]] State state() const {
+      if (!valid()) {
+        return State::Cancelled;
+      }
+
+      std::lock_guard lock{queue->mutex};
+      return job->state;
+    }
+
+    [[nodiscard]] bool ready() const { return state() == State::Done; }
+
+    void setPriority(const int priority) {
+      if (!valid()) {
+        return;
+      }
+
+      std::lock_guard lock{queue->mutex};
+      job->priority = priority;
+    }
+
+    void cancel() {
+      if (job && !dropped) {
+        dropped = true;
+        queue->cancel(job);
+      }
+    }
+
+    //  @note: runs the job on this thread if it has not started yet
+    State wait() { return valid() ? queue->wait(job) : State::Cancelled; }
+
+    //  @note: null unless done; a failed compile is done with no output
+    [[nodiscard]] std::shared_ptr<Sink> sink() const {
+      if (!valid()) {
+        return nullptr;
+      }
+
+      std::lock_guard lock{queue->mutex};
+      return job->state == State::Done ? job->sink : nullptr;
+    }
+
+    [[nodiscard]] Optional<Output> output() const {
+      if (!valid()) {
+        return {};
+      }
+
+      std::lock_guard lock{queue->mutex};
+      return job->state == State::Done ? job->output : Optional<Output>{};
+    }
+  };
+
+private:
+  VkDevice device;
+  std::shared_ptr<IncludeResolver> resolver;
+  WorkerPool &pool;
+  Execution execution;
+  MakeSink makeSink;
+
+  mutable std::mutex mutex;
+  std::condition_variable finished;
+  std::vector<std::shared_ptr<Job>> queued;
+  std::unordered_map<std::string, std::weak_ptr<Job>> pending;
+  size_t sequence = 0;
+  size_t runners = 0;
+
+public:
+  /*
+   *  @note: without a resolver every job reads its files afresh, so edits
+   *  between submissions are seen. A shared one reads each file once.
+   */
+  explicit CompileQueue(
+      const VkDevice device,
+      std::shared_ptr<IncludeResolver> resolver = nullptr,
+      WorkerPool &pool = WorkerPool::shared(),
+      const Execution execution = Execution::Serial,
+      MakeSink makeSink = [] { return std::make_unique<DefaultSink>(); })
+      : device(device), resolver(std::move(resolver)), pool(pool),
+        execution(execution), makeSink(std::move(makeSink)) {}
+
+  ~CompileQueue() {
+    std::unique_lock lock{mutex};
+    for (const auto &job : queued) {
+      job->cancellation.cancel();
+      job->state = State::Cancelled;
+    }
+
+    queued.clear();
+    pending.clear();
+    finished.wait(lock, [this] { return runners == 0; });
+  }
+
+  CompileQueue(const CompileQueue &) = delete;
+  CompileQueue &operator=(const CompileQueue &) = delete;
+
+public:
+  //  @note: higher priorities run first, equal ones in submission order
+  [[nodiscard]] Ticket submit(const std::filesystem::path &path,
+                              const int priority = 0,
+                              const Profile profile = Profile::Release) {
+    auto jobResolver =
+        resolver ? resolver : std::make_shared<IncludeResolver>();
+    auto key = fmt::format("{}:{}", name(profile), jobResolver->identity(path));
+
+    std::lock_guard lock{mutex};
+    if (const auto it = pending.find(key); it != pending.end()) {
+      if (auto job = it->second.lock(); job && job->state == State::Queued) {
+        job->tickets++;
+        job->priority = std::max(job->priority, priority);
+        return Ticket{*this, std::move(job)};
+      }
+    }
+
+    auto job = std::make_shared<Job>();
+    job->path = path;
+    job->key = key;
+    job->profile = profile;
+    job->resolver = std::move(jobResolver);
+    job->priority = priority;
+    job->sequence = sequence++;
+
+    queued.push_back(job);
+    pending.insert_or_assign(std::move(key), job);
+
+    if (runners < pool.size()) {
+      runners++;
+      static_cast<void>(pool.submit([this] { drain(); }));
+    }
+
+    return Ticket{*this, std::move(job)};
+  }
+
+  [[nodiscard]] size_t size() const {
+    std::lock_guard lock{mutex};
+    return queued.size();
+  }
+
+private:
+  //  @note: with the mutex held
+  std::shared_ptr<Job> next() {
+    if (queued.empty()) {
+      return nullptr;
+    }
+
+    const auto it = std::ranges::max_element(
+        queued, [](const auto &a, const auto &b) {
+          return a->priority != b->priority ? a->priority < b->priority
+                                            : a->sequence > b->sequence;
+        });
+
+    return start(it);
+  }
+
+  //  @note: with the mutex held
+  std::shared_ptr<Job>
+  start(const std::vector<std::shared_ptr<Job>>::iterator it) {
+    auto job = std::move(*it);
+    queued.erase(it);
+    pending.erase(job->key);
+
+    job->state = State::Running;
+    return job;
+  }
+
+  void drain() {
+    while (true) {
+      std::shared_ptr<Job> job;
+      {
+        std::lock_guard lock{mutex};
+        job = next();
+
+        if (!job) {
+          runners--;
+          finished.notify_all();
+          return;
+        }
+      }
+
+      run(*job);
+    }
+  }
+
+  void run(Job &job) {
+    std::shared_ptr<Sink> sink = makeSink();
+    auto output = compile(job.path, *sink, device, job.resolver, execution,
+                          job.profile, &job.cancellation);
+
+    bool wasted = false;
+    {
+      std::lock_guard lock{mutex};
+      if (job.cancellation.cancelled()) {
+        job.state = State::Cancelled;
+        wasted = true;
+      } else {
+        job.state = State::Done;
+        job.sink = std::move(sink);
+        job.output = std::move(output);
+      }
+
+      job.resolver.reset();
+    }
+
+    finished.notify_all();
+
+    //  @note: a compile may have finished after all tickets gave up on it
+    if (wasted) {
+      sink->unload(device);
+    }
+  }
+
+  void cancel(const std::shared_ptr<Job> &job) {
+    std::lock_guard lock{mutex};
+    if (--job->tickets > 0) {
+      return;
+    }
+
+    job->cancellation.cancel();
+    if (job->state != State::Queued) {
+      return;
+    }
+
+    job->state = State::Cancelled;
+    std::erase(queued, job);
+    pending.erase(job->key);
+
+    finished.notify_all();
+  }
+
+  State wait(const std::shared_ptr<Job> &job) {
+    std::unique_lock lock{mutex};
+    if (job->state == State::Queued) {
+      start(std::ranges::find(queued, job));
+      lock.unlock();
+
+      run(*job);
+      lock.lock();
+    }
+
+    finished.wait(lock, [&job] {
+      return job->state == State::Done || job->state == State::Cancelled;
+    });
+
+    return job->state;
+  }
+};
+
+} // namespace ryuko::compilation
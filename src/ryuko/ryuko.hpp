@@ -1,4 +1,10 @@
 #pragma once
 
+#include <ryuko/async.hpp>
+#include <ryuko/batch.hpp>
+#include <ryuko/bundle.hpp>
 #include <ryuko/compile.hpp>
+#include <ryuko/queue.hpp>
 #include <ryuko/transpile.hpp>
+#include <ryuko/variant.hpp>
+#include <ryuko/watch.hpp>
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <ryuko/pch.hpp>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace ryuko::scan {
+
+/*
+ *  Returns the index of the first byte at or after `from` that is one of
+ *  `Needles`, or `input.size()` if there is none. Compares 32 bytes at a time
+ *  with AVX2, 16 with SSE2, and falls back to a plain loop for the tail.
+ */
+template <char... Needles>
+[[nodiscard]] inline size_t findFirstOf(const std::string_view input,
+                                        size_t from) {
+  static_assert(sizeof...(Needles) > 0);
+
+  const char *data = input.data();
+  const size_t size = input.size();
+
+#if defined(__AVX2__)
+  for (; from + 32 <= size; from += 32) {
+    const __m256i chunk =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + from));
+
+    __m256i hits = _mm256_setzero_si256();
+    ((hits = _mm256_or_si256(
+          hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(Needles)))),
+     ...);
+
+    if (const auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(hits))) {
+      return from + std::countr_zero(mask);
+    }
+  }
+#endif
+
+#if defined(__SSE2__)
+  for (; from + 16 <= size; from += 16) {
+    const __m128i chunk =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + from));
+
+    __m128i hits = _mm_setzero_si128();
+    ((hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(Needles)))),
+     ...);
+
+    if (const auto mask = static_cast<uint32_t>(_mm_movemask_epi8(hits))) {
+      return from + std::countr_zero(mask);
+    }
+  }
+#endif
+
+  for (; from < size; from++) {
+    if (((data[from] == Needles) || ...)) {
+      return from;
+    }
+  }
+
+  return size;
+}
+
+} // namespace ryuko::scan
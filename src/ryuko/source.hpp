@@ -0,0 +1,220 @@
+#pragma once
+
+#include <ryuko/core.hpp>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ryuko {
+
+/*
+ *  Read-only view of a file's bytes. Large files are memory mapped where the
+ *  platform allows it, anything else is read into an owned buffer. It can
+ *  also borrow bytes someone else holds, e.g. a file packed in an archive.
+ *
+ *  A mapping is not a snapshot: pages not read yet see later writes to the
+ *  file, and reading past its end after it was truncated raises SIGBUS.
+ *  Sources, which editors save in place while a resolver holds them, stay
+ *  below the threshold and are copied instead. Map::Always maps files of any
+ *  size, for artifacts nothing rewrites.
+ *
+ *  @note: the content is not null terminated. Replace a mapped file, e.g. a
+ *  bundle, by renaming a new one over it, never by rewriting it in place.
+ */
+class SourceFile final {
+public:
+  //  files this size or larger are mapped rather than read
+  static constexpr size_t MapThreshold = 1 << 20;
+
+  enum class Map {
+    //  from MapThreshold up, for files that may be rewritten while open
+    Large,
+    //  whatever the size, for immutable artifacts such as bundles
+    Always,
+  };
+
+private:
+  const char *mapped = nullptr;
+  size_t mappedSize = 0;
+  std::string buffer;
+
+  //  @note: keeps borrowed bytes alive, mapped is not ours to unmap then
+  std::shared_ptr<const void> owner;
+  bool borrowed = false;
+
+public:
+  SourceFile() = default;
+
+  explicit SourceFile(std::string content) : buffer(std::move(content)) {}
+
+  SourceFile(const SourceFile &) = delete;
+  SourceFile &operator=(const SourceFile &) = delete;
+
+  SourceFile(SourceFile &&other) noexcept
+      : mapped(std::exchange(other.mapped, nullptr)),
+        mappedSize(std::exchange(other.mappedSize, 0)),
+        buffer(std::move(other.buffer)), owner(std::move(other.owner)),
+        borrowed(std::exchange(other.borrowed, false)) {}
+
+  SourceFile &operator=(SourceFile &&other) noexcept {
+    if (this != &other) {
+      unmap();
+
+      mapped = std::exchange(other.mapped, nullptr);
+      mappedSize = std::exchange(other.mappedSize, 0);
+      buffer = std::move(other.buffer);
+      owner = std::move(other.owner);
+      borrowed = std::exchange(other.borrowed, false);
+    }
+
+    return *this;
+  }
+
+  ~SourceFile() { unmap(); }
+
+public:
+  //  @note: content has to stay valid as long as owner is held
+  [[nodiscard]] static SourceFile view(const std::string_view content,
+                                       std::shared_ptr<const void> owner = {}) {
+    SourceFile file{};
+    file.mapped = content.data();
+    file.mappedSize = content.size();
+    file.owner = std::move(owner);
+    file.borrowed = true;
+
+    return file;
+  }
+
+  [[nodiscard]] static Optional<SourceFile>
+  open(const std::filesystem::path &path, const Map map = Map::Large) {
+#if defined(__unix__) || defined(__APPLE__)
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return {};
+    }
+
+    struct stat info {};
+    if (fstat(fd, &info) != 0) {
+      close(fd);
+      return {};
+    }
+
+    //  @note: pipes and devices report no useful size, they are read to EOF
+    const auto size =
+        S_ISREG(info.st_mode) ? static_cast<size_t>(info.st_size) : 0;
+
+    //  @note: an empty file cannot be mapped
+    if (size >= MapThreshold || (map == Map::Always && size > 0)) {
+      void *address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (address != MAP_FAILED) {
+        close(fd);
+
+        SourceFile file{};
+        file.mapped = static_cast<const char *>(address);
+        file.mappedSize = size;
+
+        return file;
+      }
+    }
+
+    auto file = read(fd, size);
+    close(fd);
+
+    return file;
+#else
+    static_cast<void>(map);
+    return read(path);
+#endif
+  }
+
+  [[nodiscard]] std::string_view content() const {
+    if (mapped) {
+      return {mapped, mappedSize};
+    }
+
+    return buffer;
+  }
+
+  [[nodiscard]] bool isMapped() const { return mapped && !borrowed; }
+
+private:
+#if defined(__unix__) || defined(__APPLE__)
+  //  @note: size is a hint, the file may have grown or shrunk since
+  [[nodiscard]] static Optional<SourceFile> read(const int fd,
+                                                 const size_t size) {
+    std::string content(size, '\0');
+    size_t filled = 0;
+
+    std::array<char, 4096> chunk{};
+    while (true) {
+      const bool full = filled == content.size();
+      const auto count =
+          ::read(fd, full ? chunk.data() : content.data() + filled,
+                 full ? chunk.size() : content.size() - filled);
+
+      if (count < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+
+        return {};
+      }
+
+      if (count == 0) {
+        break;
+      }
+
+      if (full) {
+        content.append(chunk.data(), static_cast<size_t>(count));
+      }
+
+      filled += static_cast<size_t>(count);
+    }
+
+    content.resize(filled);
+    return SourceFile{std::move(content)};
+  }
+#else
+  [[nodiscard]] static Optional<SourceFile>
+  read(const std::filesystem::path &path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+      return {};
+    }
+
+    const auto size = file.tellg();
+    if (size < 0) {
+      return {};
+    }
+
+    std::string content(static_cast<size_t>(size), '\0');
+    file.seekg(0);
+    file.read(content.data(), static_cast<std::streamsize>(content.size()));
+
+    //  @note: the file may have shrunk since its size was taken
+    content.resize(static_cast<size_t>(file.gcount()));
+
+    return SourceFile{std::move(content)};
+  }
+#endif
+
+  void unmap() {
+#if defined(__unix__) || defined(__APPLE__)
+    if (mapped && !borrowed) {
+      munmap(const_cast<char *>(mapped), mappedSize);
+    }
+#endif
+
+    mapped = nullptr;
+    mappedSize = 0;
+    owner.reset();
+    borrowed = false;
+  }
+};
+
+} // namespace ryuko
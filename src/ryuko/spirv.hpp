@@ -0,0 +1,272 @@
+#pragma once
+
+#include <ryuko/core.hpp>
+#include <ryuko/includer.hpp>
+#include <ryuko/parser.hpp>
+#include <ryuko/source.hpp>
+
+namespace ryuko {
+
+/*
+ *  64-bit hash that, unlike std::hash, is the same across runs and builds,
+ *  for keys that are persisted. Consumes eight bytes per step.
+ *
+ *  @note: bytes are read in host order, keys differ between endiannesses
+ */
+class Digest final {
+  uint64_t state;
+
+public:
+  explicit Digest(const uint64_t seed = 0)
+      : state(mix(seed ^ 0x9e3779b97f4a7c15ull)) {}
+
+public:
+  Digest &add(const uint64_t value) {
+    state = mix(state ^ value);
+    return *this;
+  }
+
+  Digest &add(const std::string_view text) {
+    add(static_cast<uint64_t>(text.size()));
+
+    size_t i = 0;
+    for (; i + 8 <= text.size(); i += 8) {
+      uint64_t chunk;
+      std::memcpy(&chunk, text.data() + i, 8);
+      add(chunk);
+    }
+
+    if (i < text.size()) {
+      uint64_t chunk = 0;
+      std::memcpy(&chunk, text.data() + i, text.size() - i);
+      add(chunk);
+    }
+
+    return *this;
+  }
+
+  [[nodiscard]] uint64_t value() const { return state; }
+
+private:
+  [[nodiscard]] static constexpr uint64_t mix(uint64_t x) {
+    x ^= x >> 32;
+    x *= 0xd6e8feb86659fd93ull;
+    x ^= x >> 32;
+    x *= 0xd6e8feb86659fd93ull;
+    x ^= x >> 32;
+
+    return x;
+  }
+};
+
+/*
+ *  Compiled stages on disk, one `<key>.spv` file of plain SPIR-V per entry,
+ *  so restarts and CI builds skip shaderc for shaders that did not change.
+ *  The key covers the stage source, the content of every file it includes
+ *  and the compile options, so entries never need invalidating, a changed
+ *  input just makes a new key.
+ *
+ *  Entries are written to a temporary file and renamed into place, readers
+ *  and concurrent writers of the same key never see a partial file.
+ *
+ *  @note: disabled until given a directory, entries are never evicted
+ */
+class SpirvCache final {
+public:
+  //  @note: bump when the way keys or entries are made changes
+  static constexpr uint64_t Version = 1;
+  static constexpr uint32_t SpirvMagic = 0x07230203;
+
+private:
+  mutable std::mutex mutex;
+  std::filesystem::path root;
+
+public:
+  SpirvCache() = default;
+
+  explicit SpirvCache(std::filesystem::path directory)
+      : root(std::move(directory)) {}
+
+  SpirvCache(const SpirvCache &) = delete;
+  SpirvCache &operator=(const SpirvCache &) = delete;
+
+public:
+  [[nodiscard]] static SpirvCache &shared() {
+    static SpirvCache cache;
+    return cache;
+  }
+
+  /*
+   *  `seed` stands for everything else the output depends on (stage, compile
+   *  options). Includes are resolved the way shaderc will, through the
+   *  session's resolver, whose files are already in memory.
+   */
+  [[nodiscard]] static uint64_t key(const std::string_view source,
+                                    const std::filesystem::path &inputFilePath,
+                                    const uint64_t seed,
+                                    IncludeResolver *resolver) {
+    Digest digest{Version};
+    digest.add(seed).add(inputFilePath.generic_string()).add(source);
+
+    std::unordered_set<const IncludeResolver::File *> seen;
+    dependencies(digest, source, inputFilePath, resolver, seen);
+
+    return digest.value();
+  }
+
+public:
+  void setDirectory(std::filesystem::path directory) {
+    std::lock_guard lock{mutex};
+    root = std::move(directory);
+  }
+
+  [[nodiscard]] std::filesystem::path directory() const {
+    std::lock_guard lock{mutex};
+    return root;
+  }
+
+  [[nodiscard]] bool enabled() const {
+    std::lock_guard lock{mutex};
+    return !root.empty();
+  }
+
+  [[nodiscard]] Optional<std::vector<uint32_t>>
+  find(const uint64_t key) const {
+    const auto file = SourceFile::open(entry(directory(), key));
+    if (!file.has_value()) {
+      return {};
+    }
+
+    const auto bytes = file->content();
+    if (bytes.size() < sizeof(uint32_t) || bytes.size() % sizeof(uint32_t)) {
+      return {};
+    }
+
+    std::vector<uint32_t> code(bytes.size() / sizeof(uint32_t));
+    std::memcpy(code.data(), bytes.data(), bytes.size());
+
+    if (!valid(code)) {
+      error("[cache] ignoring corrupt entry {:016x}", key);
+      return {};
+    }
+
+    return code;
+  }
+
+  void store(const uint64_t key, const std::span<const uint32_t> code) const {
+    const auto folder = directory();
+    if (folder.empty()) {
+      return;
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(folder, ec);
+
+    const auto target = entry(folder, key);
+    auto temporary = target;
+    temporary += fmt::format(".{:016x}.tmp", unique());
+
+    {
+      std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+      out.write(reinterpret_cast<const char *>(code.data()),
+                static_cast<std::streamsize>(code.size_bytes()));
+
+      if (!out) {
+        error("[cache] failed to write {}", temporary.c_str());
+        out.close();
+        std::filesystem::remove(temporary, ec);
+        return;
+      }
+    }
+
+    std::filesystem::rename(temporary, target, ec);
+    if (ec) {
+      error("[cache] failed to store {}: {}", target.c_str(), ec.message());
+      std::filesystem::remove(temporary, ec);
+    }
+  }
+
+private:
+  static constexpr size_t SpirvHeaderWords = 5;
+
+  /*
+   *  The header, then instructions that exactly fill the rest, which a file
+   *  cut short or mixed up with another write rarely does.
+   */
+  [[nodiscard]] static bool valid(const std::span<const uint32_t> code) {
+    if (code.size() < SpirvHeaderWords || code[0] != SpirvMagic ||
+        (code[1] >> 16) != 1 || code[3] == 0 || code[4] != 0) {
+      return false;
+    }
+
+    size_t at = SpirvHeaderWords;
+    while (at < code.size()) {
+      const auto words = code[at] >> 16;
+      if (words == 0) {
+        return false;
+      }
+
+      at += words;
+    }
+
+    return at == code.size();
+  }
+
+  /*
+   *  Names a temporary file no other writer uses, in this process or any
+   *  other process sharing the directory.
+   */
+  [[nodiscard]] static uint64_t unique() {
+    static std::atomic<uint64_t> counter = 0;
+
+    std::random_device random;
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+
+    return Digest{counter.fetch_add(1, std::memory_order_relaxed)}
+        .add((static_cast<uint64_t>(random()) << 32) | random())
+        .add(static_cast<uint64_t>(now.count()))
+        .add(std::hash<std::thread::id>{}(std::this_thread::get_id()))
+        .value();
+  }
+
+  [[nodiscard]] static std::filesystem::path
+  entry(const std::filesystem::path &folder, const uint64_t key) {
+    return folder / fmt::format("{:016x}.spv", key);
+  }
+
+  static void
+  dependencies(Digest &digest, const std::string_view source,
+               const std::filesystem::path &path, IncludeResolver *resolver,
+               std::unordered_set<const IncludeResolver::File *> &seen) {
+    for (size_t at = scan::findFirstOf<'#'>(source, 0); at < source.size();
+         at = scan::findFirstOf<'#'>(source, at + 1)) {
+      auto directive = source.substr(at + 1);
+      directive = directive.substr(0, directive.find('\n'));
+      directive.remove_prefix(
+          std::min(directive.find_first_not_of(" \t"), directive.size()));
+
+      const auto include = Parser::include(directive);
+      if (!include.has_value()) {
+        continue;
+      }
+
+      //  @note: a missing include fails the compile, which is never stored
+      const auto *file =
+          resolver ? resolver->include(include->file, path, include->relative)
+                   : nullptr;
+      if (!file) {
+        digest.add(include->file);
+        continue;
+      }
+
+      if (!seen.insert(file).second) {
+        continue;
+      }
+
+      digest.add(file->path).add(file->content());
+      dependencies(digest, file->content(), file->path, resolver, seen);
+    }
+  }
+};
+
+} // namespace ryuko
@@ -8,6 +8,9 @@ namespace ryuko::transpilation {
 
 struct Output : Emitter::Output {
   int version;
+
+  //  every file the shader includes, directly or not, by identity
+  std::vector<std::string> includes;
 };
 
 struct Sink {
@@ -44,6 +47,9 @@ public:
 struct FileSink final : Sink {
   void write(const std::filesystem::path &path,
              const Emitter::Output &code) override {
+    this->fragment = code.fragment;
+    this->vertex = code.vertex;
+
     auto basePath = path.parent_path();
 
     std::filesystem::path vertPath(
@@ -82,10 +88,22 @@ public:
   }
 };
 
+/*
+ *  Shader source from memory, e.g. generated by a tool, `path` names it in
+ *  messages and outputs and anchors its relative includes.
+ */
 [[maybe_unused]]
-static Optional<Output> transpile(const std::filesystem::path &path,
-                                  Sink &sink) {
-  auto maybeProcessedOutput = process(path);
+static Optional<Output>
+transpile(const std::string_view source, const std::filesystem::path &path,
+          Sink &sink,
+          const std::shared_ptr<IncludeResolver> &resolver =
+              std::make_shared<IncludeResolver>(),
+          const Execution execution = Execution::Serial) {
+  //  @note: everything parsed for this shader is released in one go on return
+  std::pmr::monotonic_buffer_resource arena{ArenaInitialSize};
+
+  auto maybeProcessedOutput =
+      process(source, path, &arena, resolver, execution);
   if (!maybeProcessedOutput.has_value()) {
     return {};
   }
@@ -95,32 +113,11 @@ static Optional<Output> transpile(const std::filesystem::path &path,
 
   sink.write(path, emitterOutput);
 
-  sink.storageBuffers = context.storageBuffers;
-  sink.inputs = context.inputs;
-  sink.uniforms = context.uniforms;
-  sink.config = context.config;
-
-  //  @temp(v2f): generate vertex input struct
-  {
-    std::vector<Varying> vertexInputs;
-    std::vector<Varying> varyings;
-    std::vector<Varying> fragmentOutputs;
-
-    for (auto &varying : context.varyings) {
-      if (varying.vertexInput) {
-        vertexInputs.push_back(varying);
-      } else if (varying.fragmentOutput) {
-        fragmentOutputs.push_back(varying);
-      } else {
-        varyings.push_back(varying);
-      }
-    }
-
-    sink.vertexInputs = vertexInputs;
-  }
+  auto includes = reflect(context, sink);
 
   Output o{};
   o.version = context.version;
+  o.includes = std::move(includes);
 
   //  @fixme: what is this used for?
   o.fragment = path.parent_path() / fmt::format("{}.frag", path.stem().c_str());
@@ -129,4 +126,24 @@ static Optional<Output> transpile(const std::filesystem::path &path,
   return o;
 }
 
+/*
+ *  @note: pass a resolver to read sources through another SourceProvider or
+ *  with include search paths, or to share loaded files between shaders
+ */
+[[maybe_unused]]
+static Optional<Output>
+transpile(const std::filesystem::path &path, Sink &sink,
+          const std::shared_ptr<IncludeResolver> &resolver =
+              std::make_shared<IncludeResolver>(),
+          const Execution execution = Execution::Serial) {
+  const auto *file = resolver->load(path);
+  if (!file) {
+    error("failed to open file {}", path.c_str());
+
+    return {};
+  }
+
+  return transpile(file->content(), path, sink, resolver, execution);
+}
+
 } // namespace ryuko::transpilation
\ No newline at end of file
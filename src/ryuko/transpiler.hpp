@@ -5,12 +5,12 @@
 namespace ryuko {
 
 struct Transpiler {
-  std::vector<Function> &functions;
-  std::vector<Varying> &varyings;
+  std::pmr::vector<Function> &functions;
+  std::pmr::vector<Varying> &varyings;
 
 public:
-  explicit Transpiler(std::vector<Function> &functions,
-                      std::vector<Varying> &varyings)
+  explicit Transpiler(std::pmr::vector<Function> &functions,
+                      std::pmr::vector<Varying> &varyings)
       : functions(functions), varyings(varyings) {}
 
 public:
@@ -21,30 +21,13 @@ public:
       return;
     }
 
-    if (auto expression = extractReturnExpression(*vert);
-        expression.has_value()) {
-      if (const auto index = vert->body.find("return");
-          index != std::string::npos) {
-        vert->body = vert->body.substr(0, index);
-        vert->body +=
-            fmt::format("gl_Position = {};\n{}", expression.value(), "}");
-      }
-    } else {
+    if (!rewriteReturns(*vert, "gl_Position")) {
       error("vert() must return a vec4");
     }
 
     if (Function *frag = findFunction(FragFunctionName)) {
-      if (auto expression = extractReturnExpression(*frag);
-          expression.has_value()) {
-        if (const auto index = frag->body.find("return");
-            index != std::string::npos) {
-          const Varying outColor{"ryuko_outColor", "vec4", "highp"};
-          frag->body = frag->body.substr(0, index);
-          frag->body += fmt::format("{} = {};\n{}", outColor.name,
-                                    expression.value(), "}");
-
-          varyings.push_back(outColor);
-        }
+      if (rewriteReturns(*frag, "ryuko_outColor")) {
+        varyings.emplace_back("ryuko_outColor", "vec4", "highp");
       } else {
         error("frag() must return a vec4");
       }
@@ -52,24 +35,129 @@ public:
   }
 
 private:
-  [[nodiscard]]
-  static Optional<std::string>
-  extractReturnExpression(const Function &function) {
-    const auto &body = function.body;
-    if (const auto index = body.find("return"); index != std::string::npos) {
-      const auto start = index + 6;
-      if (const auto end = body.find_first_of(';', start);
-          end != std::string::npos) {
-        Parser p{std::string{body.begin() + start, body.begin() + end}};
-        p.consumeWhitespace();
-        return p.consumeUntil(";");
+  //  a `return <expression>;` to turn into an assignment, [begin, end)
+  struct Return {
+    size_t begin;
+    size_t end;
+    std::string_view expression;
+    bool last;
+  };
+
+  /*
+   *  Turns every `return <expression>;` into an assignment to target. The one
+   *  ending the body becomes a plain assignment, any earlier one still has to
+   *  leave the function, so it keeps a bare `return;` after the assignment.
+   *  Returns inside statements the AST kept as Unknown are found by their
+   *  tokens instead.
+   */
+  static bool rewriteReturns(Function &function,
+                             const std::string_view target) {
+    const auto &ast = function.ast;
+    if (ast.empty()) {
+      return false;
+    }
+
+    const std::string_view source = function.body;
+    const auto last = ast.lastChild(ast.root);
+
+    std::pmr::vector<Return> returns{function.body.get_allocator()};
+    for (Ast::Index i = 0; i < ast.nodes.size(); i++) {
+      const auto &node = ast[i];
+
+      if (node.kind == Ast::Kind::Return && node.firstChild != Ast::None) {
+        returns.push_back(Return{node.begin, node.end,
+                                 Ast::span(ast[node.firstChild], source),
+                                 i == last});
+      } else if (node.kind == Ast::Kind::Unknown &&
+                 !unparsedReturns(node, source, returns)) {
+        error("{}(): no ';' ends the return in `{}`", function.name,
+              Ast::span(node, source));
+        return false;
       }
     }
 
-    return {};
-  };
+    if (returns.empty()) {
+      return false;
+    }
+
+    std::ranges::sort(returns, {}, &Return::begin);
+
+    //  @note: the expressions view the old body, build the new one aside
+    std::pmr::string body{function.body.get_allocator()};
+    body.reserve(source.size() + returns.size() * (target.size() + 16));
+
+    size_t copied = 0;
+    for (const auto &value : returns) {
+      body.append(source.substr(copied, value.begin - copied));
+      if (value.last) {
+        fmt::format_to(std::back_inserter(body), "{} = {};", target,
+                       value.expression);
+      } else {
+        fmt::format_to(std::back_inserter(body), "{{ {} = {}; return; }}",
+                       target, value.expression);
+      }
+
+      copied = value.end;
+    }
+
+    body.append(source.substr(copied));
+
+    function.body = std::move(body);
+    function.ast = Ast::parse(function.body, function.body.get_allocator());
+
+    return true;
+  }
+
+  /*
+   *  The returns of a statement the AST could not parse: `return`, then
+   *  everything up to the ';' at its own nesting depth.
+   *
+   *  @note: false if a return is not ended by a ';' within the statement
+   */
+  static bool unparsedReturns(const Ast::Node &node,
+                              const std::string_view source,
+                              std::pmr::vector<Return> &returns) {
+    const auto statement = Ast::span(node, source);
+    Lexer lexer{statement};
+
+    for (auto token = lexer.next(); !token.end(); token = lexer.next()) {
+      if (!token.is("return")) {
+        continue;
+      }
+
+      const auto first = lexer.peek();
+
+      size_t depth = 0;
+      auto end = lexer.next();
+      for (; !end.end() && (depth > 0 || !end.is(';')); end = lexer.next()) {
+        if (end.is('(') || end.is('[') || end.is('{')) {
+          ++depth;
+        } else if ((end.is(')') || end.is(']') || end.is('}')) && depth > 0) {
+          --depth;
+        }
+      }
+
+      if (end.end()) {
+        return false;
+      }
+
+      //  @note: a bare `return;` has nothing to assign
+      if (first.offset < end.offset) {
+        auto expression =
+            statement.substr(first.offset, end.offset - first.offset);
+        expression = expression.substr(
+            0, expression.find_last_not_of(" \t\r\n") + 1);
+
+        returns.push_back(Return{node.begin + token.offset,
+                                 node.begin + lexer.offset(), expression,
+                                 false});
+      }
+    }
+
+    return true;
+  }
 
-  [[nodiscard]] Function *findFunction(const std::string &name) const {
+  [[nodiscard]] Function *findFunction(const std::string_view name) const {
     const auto it = std::ranges::find_if(
         functions, [&](const auto &f) { return f.name == name; });
     return (it != std::ranges::end(functions)) ? &(*it) : nullptr;
@@ -0,0 +1,280 @@
+#pragma once
+
+#include <ryuko/compile.hpp>
+#include <ryuko/pool.hpp>
+
+namespace ryuko::compilation {
+
+//  keyword defines of one permutation, `NAME` or `NAME=VALUE`
+using Defines = std::vector<std::string>;
+
+//  @note: the same for any order or repetition of the defines
+[[maybe_unused, nodiscard]] static std::string
+permutation(const std::span<const std::string> defines) {
+  std::vector<std::string_view> sorted{defines.begin(), defines.end()};
+  std::ranges::sort(sorted);
+  const auto [first, last] = std::ranges::unique(sorted);
+  sorted.erase(first, last);
+
+  std::string key;
+  for (const auto define : sorted) {
+    if (!key.empty()) {
+      key += ';';
+    }
+
+    key += define;
+  }
+
+  return key;
+}
+
+/*
+ *  The `#define` lines of a permutation.
+ *
+ *  @note: empty if a name is not an identifier or a value spans lines
+ */
+[[maybe_unused, nodiscard]] static Optional<std::string>
+defineLines(const std::span<const std::string> defines) {
+  std::string lines;
+
+  for (const std::string_view define : defines) {
+    const auto equals = std::min(define.find('='), define.size());
+    const auto name = define.substr(0, equals);
+    const auto value = define.substr(std::min(equals + 1, define.size()));
+
+    const bool identifier =
+        !name.empty() && !std::isdigit(static_cast<unsigned char>(name[0])) &&
+        std::ranges::all_of(name, [](const char c) {
+          return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+        });
+
+    if (!identifier || value.find('\n') != std::string_view::npos) {
+      error("[variant] invalid define {}", define);
+      return {};
+    }
+
+    lines += fmt::format("#define {} {}\n", name, value);
+  }
+
+  return lines;
+}
+
+/*
+ *  The permutations of one shader. The shader is parsed and emitted once,
+ *  permutations only differ in the defines shaderc sees, which go right
+ *  after the `#version` line of each stage. Every permutation built is kept
+ *  by its key, so asking again, in any define order, builds nothing. With a
+ *  SPIR-V cache directory the stages are also reused across runs.
+ *
+ *  @note: defines select code inside function bodies and includes, the
+ *  declarations ryuko reflects are the same for every permutation
+ */
+class Variants final {
+public:
+  struct Variant {
+    std::string key;
+    ShaderCompilationResult spirv;
+
+    //  whether the shader has a fragment stage to compile
+    bool expectsFragment = false;
+
+  public:
+    [[nodiscard]] bool succeeded() const {
+      return spirv.vertexCode.has_value() &&
+             (!expectsFragment || spirv.fragmentCode.has_value());
+    }
+  };
+
+private:
+  //  @note: only holds the reflected resources, writes nothing
+  struct Reflection final : Sink {
+    void write([[maybe_unused]] const std::filesystem::path &path,
+               [[maybe_unused]] const Emitter::Output &code,
+               [[maybe_unused]] const VkDevice device,
+               [[maybe_unused]] const WriteOptions &options) override {}
+  };
+
+  std::filesystem::path path;
+  std::shared_ptr<IncludeResolver> resolver;
+  Profile profile;
+
+  Emitter::Output code;
+  Output output;
+  Reflection reflection;
+
+  mutable std::mutex mutex;
+  std::unordered_map<std::string, std::shared_ptr<const Variant>> built;
+
+  Variants(std::filesystem::path path,
+           std::shared_ptr<IncludeResolver> resolver, const Profile profile)
+      : path(std::move(path)), resolver(std::move(resolver)),
+        profile(profile) {}
+
+public:
+  //  @note: null if the shader does not parse or emit
+  [[nodiscard]] static std::unique_ptr<Variants>
+  open(const std::filesystem::path &path,
+       std::shared_ptr<IncludeResolver> resolver =
+           std::make_shared<IncludeResolver>(),
+       const Profile profile = Profile::Release) {
+    std::unique_ptr<Variants> variants{
+        new Variants{path, std::move(resolver), profile}};
+
+    std::pmr::monotonic_buffer_resource arena{ArenaInitialSize};
+
+    auto processed = process(path, &arena, variants->resolver);
+    if (!processed.has_value()) {
+      return nullptr;
+    }
+
+    const auto &context = processed->context;
+
+    variants->code = std::move(processed->output);
+    variants->output.version = context.version;
+    variants->output.includes = reflect(context, variants->reflection);
+    variants->output.vertex = path.parent_path() /
+                              fmt::format("{}.vert", path.stem().c_str());
+    variants->output.fragment = path.parent_path() /
+                                fmt::format("{}.frag", path.stem().c_str());
+
+    return variants;
+  }
+
+public:
+  /*
+   *  Builds the permutations not built yet, one job each on the pool.
+   *
+   *  @note: results are in the order of `permutations`, a permutation that
+   *  fails to compile is kept too, see Variant::succeeded()
+   */
+  std::vector<std::shared_ptr<const Variant>>
+  build(const std::span<const Defines> permutations,
+        WorkerPool &pool = WorkerPool::shared()) {
+    std::vector<std::shared_ptr<const Variant>> results(permutations.size());
+    std::unordered_map<std::string, std::vector<size_t>> missing;
+
+    {
+      std::lock_guard lock{mutex};
+      for (size_t i = 0; i < permutations.size(); i++) {
+        auto key = permutation(permutations[i]);
+        if (const auto it = built.find(key); it != built.end()) {
+          results[i] = it->second;
+        } else {
+          missing[std::move(key)].push_back(i);
+        }
+      }
+    }
+
+    std::vector<std::pair<const std::vector<size_t> *,
+                          WorkerPool::Task<std::shared_ptr<const Variant>>>>
+        pending;
+    pending.reserve(missing.size());
+
+    for (const auto &[key, indices] : missing) {
+      pending.emplace_back(
+          &indices,
+          pool.submit([this, &key, &defines = permutations[indices.front()]] {
+            return std::make_shared<const Variant>(compile(key, defines));
+          }));
+    }
+
+    for (auto &[indices, job] : pending) {
+      auto variant = pool.wait(job);
+
+      std::lock_guard lock{mutex};
+      const auto [it, inserted] = built.try_emplace(variant->key, variant);
+      for (const auto i : *indices) {
+        results[i] = it->second;
+      }
+    }
+
+    return results;
+  }
+
+  [[nodiscard]] std::shared_ptr<const Variant>
+  find(const std::span<const std::string> defines) const {
+    std::lock_guard lock{mutex};
+    const auto it = built.find(permutation(defines));
+    return it != built.end() ? it->second : nullptr;
+  }
+
+  /*
+   *  Fills the sink like compile() does, building the permutation first if
+   *  needed.
+   *
+   *  @note: the sink's write() is not called, only its shader modules and
+   *  reflected resources are set
+   */
+  Optional<Output> load(const Defines &defines, Sink &sink,
+                        const VkDevice device,
+                        WorkerPool &pool = WorkerPool::shared()) {
+    auto variant = find(defines);
+    if (!variant) {
+      variant = build({&defines, 1}, pool).front();
+    }
+
+    if (!variant->succeeded()) {
+      return {};
+    }
+
+    sink.config = reflection.config;
+    sink.vertexInputs = reflection.vertexInputs;
+    sink.inputs = reflection.inputs;
+    sink.storageBuffers = reflection.storageBuffers;
+    sink.uniforms = reflection.uniforms;
+    sink.load(device, variant->spirv, path);
+
+    return output;
+  }
+
+  [[nodiscard]] size_t size() const {
+    std::lock_guard lock{mutex};
+    return built.size();
+  }
+
+private:
+  [[nodiscard]] Variant compile(const std::string &key,
+                                const Defines &defines) const {
+    Variant variant{key, {},
+                    code.fragment.has_value() && !code.fragment->empty()};
+
+    const auto lines = defineLines(defines);
+    if (!lines.has_value()) {
+      return variant;
+    }
+
+    Emitter::Output specialized{};
+    specialized.vertex = specialize(code.vertex, lines.value());
+    if (code.fragment.has_value()) {
+      specialized.fragment = specialize(code.fragment.value(), lines.value());
+    }
+
+    variant.spirv =
+        compilation::compile(path, specialized, resolver, Execution::Serial,
+                             CompilerContext::local(profile));
+    return variant;
+  }
+
+  //  @note: defines may not come before `#version`
+  [[nodiscard]] static std::string specialize(const std::string_view stage,
+                                              const std::string_view lines) {
+    size_t at = 0;
+    if (stage.starts_with("#version")) {
+      at = std::min(stage.find('\n'), stage.size());
+      at = std::min(at + 1, stage.size());
+    }
+
+    std::string source;
+    source.reserve(stage.size() + lines.size() + 1);
+    source.append(stage.substr(0, at));
+    if (at > 0 && source.back() != '\n') {
+      source += '\n';
+    }
+
+    source.append(lines);
+    source.append(stage.substr(at));
+    return source;
+  }
+};
+
+} // namespace ryuko::compilation
@@ -0,0 +1,258 @@
+#pragma once
+
+#include <ryuko/core.hpp>
+#include <ryuko/source.hpp>
+
+namespace ryuko {
+
+/*
+ *  Where shader sources and their includes are read from. A compilation
+ *  session asks its provider for every file, so shaders can come from disk,
+ *  from memory or from a packed archive without the rest knowing.
+ */
+struct SourceProvider {
+  virtual ~SourceProvider() = default;
+
+  //  @note: empty if the provider does not have the file
+  [[nodiscard]] virtual Optional<SourceFile>
+  open(const std::filesystem::path &path) = 0;
+
+  //  the name a file is known by, two paths to the same file give the same
+  [[nodiscard]] virtual std::string
+  identity(const std::filesystem::path &path) const {
+    return normalize(path);
+  }
+
+  [[nodiscard]] static std::string
+  normalize(const std::filesystem::path &path) {
+    auto normal = path.lexically_normal().generic_string();
+    while (normal.starts_with("./")) {
+      normal.erase(0, 2);
+    }
+
+    return normal;
+  }
+};
+
+struct DiskSourceProvider final : SourceProvider {
+  [[nodiscard]] Optional<SourceFile>
+  open(const std::filesystem::path &path) override {
+    return SourceFile::open(path);
+  }
+
+  [[nodiscard]] std::string
+  identity(const std::filesystem::path &path) const override {
+    std::error_code ec;
+    const auto result = std::filesystem::weakly_canonical(path, ec);
+
+    return ec ? path.string() : result.string();
+  }
+};
+
+/*
+ *  Files handed over as strings, e.g. generated code or sources the engine
+ *  already loaded. Opened files borrow the stored string, replacing a file
+ *  leaves earlier views intact.
+ */
+class MemorySourceProvider final : public SourceProvider {
+  mutable std::mutex mutex;
+  std::unordered_map<std::string, std::shared_ptr<const std::string>> files;
+
+public:
+  void add(const std::filesystem::path &path, std::string content) {
+    auto file = std::make_shared<const std::string>(std::move(content));
+
+    std::lock_guard lock{mutex};
+    files[normalize(path)] = std::move(file);
+  }
+
+  void remove(const std::filesystem::path &path) {
+    std::lock_guard lock{mutex};
+    files.erase(normalize(path));
+  }
+
+  [[nodiscard]] Optional<SourceFile>
+  open(const std::filesystem::path &path) override {
+    std::lock_guard lock{mutex};
+
+    const auto it = files.find(normalize(path));
+    if (it == files.end()) {
+      return {};
+    }
+
+    return SourceFile::view(*it->second, it->second);
+  }
+};
+
+/*
+ *  Every source packed in one blob, so loading a shader library is one file
+ *  open (and one mapping) instead of one per file.
+ *
+ *  Layout, little endian, offsets from the start of the blob:
+ *    Header                  magic "RYKA", version, entry count
+ *    Entry[count]            path and content ranges
+ *    paths and contents      back to back, contents aligned to 8 bytes
+ */
+class ArchiveSourceProvider final : public SourceProvider {
+public:
+  static constexpr std::array<char, 4> Magic{'R', 'Y', 'K', 'A'};
+  static constexpr uint32_t Version = 1;
+
+  struct Header {
+    std::array<char, 4> magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t reserved;
+  };
+
+  struct Entry {
+    uint64_t pathOffset;
+    uint64_t pathSize;
+    uint64_t contentOffset;
+    uint64_t contentSize;
+  };
+
+  static_assert(sizeof(Header) == 16 && sizeof(Entry) == 32);
+
+  //  @note: fields are written and read in host order
+  static_assert(std::endian::native == std::endian::little,
+                "archives are little endian");
+
+private:
+  std::shared_ptr<const SourceFile> blob;
+  std::unordered_map<std::string_view, std::string_view> files;
+
+public:
+  [[nodiscard]] static std::shared_ptr<ArchiveSourceProvider>
+  mount(const std::filesystem::path &path) {
+    //  @note: an archive never changes once packed, map it whatever its size
+    auto file = SourceFile::open(path, SourceFile::Map::Always);
+    if (!file.has_value()) {
+      error("failed to open archive {}", path.c_str());
+      return nullptr;
+    }
+
+    return load(std::move(file.value()));
+  }
+
+  [[nodiscard]] static std::shared_ptr<ArchiveSourceProvider>
+  load(SourceFile file) {
+    auto archive = std::make_shared<ArchiveSourceProvider>();
+    archive->blob = std::make_shared<const SourceFile>(std::move(file));
+
+    if (!archive->index()) {
+      return nullptr;
+    }
+
+    return archive;
+  }
+
+  //  @note: paths are stored normalized, as open() looks them up
+  [[nodiscard]] static std::string pack(
+      const std::vector<std::pair<std::filesystem::path, std::string>>
+          &sources) {
+    const auto align = [](const uint64_t offset) {
+      return (offset + 7) & ~uint64_t{7};
+    };
+
+    std::vector<std::string> paths;
+    paths.reserve(sources.size());
+
+    uint64_t size = sizeof(Header) + sources.size() * sizeof(Entry);
+    for (const auto &[path, content] : sources) {
+      paths.push_back(normalize(path));
+      size = align(size + paths.back().size()) + content.size();
+    }
+
+    std::string blob(size, '\0');
+
+    const Header header{Magic, Version, static_cast<uint32_t>(sources.size()),
+                        0};
+    std::memcpy(blob.data(), &header, sizeof(header));
+
+    uint64_t offset = sizeof(Header) + sources.size() * sizeof(Entry);
+    for (size_t i = 0; i < sources.size(); i++) {
+      const auto &content = sources[i].second;
+
+      Entry entry{};
+      entry.pathOffset = offset;
+      entry.pathSize = paths[i].size();
+      entry.contentOffset = align(offset + paths[i].size());
+      entry.contentSize = content.size();
+
+      std::memcpy(blob.data() + entry.pathOffset, paths[i].data(),
+                  entry.pathSize);
+      std::memcpy(blob.data() + entry.contentOffset, content.data(),
+                  entry.contentSize);
+      std::memcpy(blob.data() + sizeof(Header) + i * sizeof(Entry), &entry,
+                  sizeof(entry));
+
+      offset = entry.contentOffset + entry.contentSize;
+    }
+
+    return blob;
+  }
+
+public:
+  [[nodiscard]] Optional<SourceFile>
+  open(const std::filesystem::path &path) override {
+    const auto it = files.find(normalize(path));
+    if (it == files.end()) {
+      return {};
+    }
+
+    return SourceFile::view(it->second, blob);
+  }
+
+  [[nodiscard]] size_t size() const { return files.size(); }
+
+  //  @note: false for an archive loaded from memory
+  [[nodiscard]] bool isMapped() const { return blob->isMapped(); }
+
+private:
+  bool index() {
+    const auto data = blob->content();
+
+    Header header{};
+    if (data.size() < sizeof(header)) {
+      error("archive is truncated");
+      return false;
+    }
+
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (header.magic != Magic || header.version != Version) {
+      error("not a ryuko archive, or version {} is not supported",
+            header.version);
+      return false;
+    }
+
+    if ((data.size() - sizeof(Header)) / sizeof(Entry) < header.count) {
+      error("archive is truncated");
+      return false;
+    }
+
+    const auto within = [&](const uint64_t offset, const uint64_t size) {
+      return offset <= data.size() && size <= data.size() - offset;
+    };
+
+    files.reserve(header.count);
+    for (uint32_t i = 0; i < header.count; i++) {
+      Entry entry{};
+      std::memcpy(&entry, data.data() + sizeof(Header) + i * sizeof(Entry),
+                  sizeof(entry));
+
+      if (!within(entry.pathOffset, entry.pathSize) ||
+          !within(entry.contentOffset, entry.contentSize)) {
+        error("archive entry {} is out of bounds", i);
+        return false;
+      }
+
+      files.emplace(data.substr(entry.pathOffset, entry.pathSize),
+                    data.substr(entry.contentOffset, entry.contentSize));
+    }
+
+    return true;
+  }
+};
+
+} // namespace ryuko
@@ -0,0 +1,292 @@
+#pragma once
+
+#include <ryuko/compile.hpp>
+#include <ryuko/includes.hpp>
+#include <ryuko/pool.hpp>
+#include <ryuko/vfs.hpp>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace ryuko {
+
+/*
+ *  Recompiles shaders when they, or anything they include, change on disk.
+ *  A shader is compiled once when watched, which records the files it
+ *  includes. After that an edit rebuilds exactly the shaders that depend on
+ *  the edited file, in parallel, and hands each of them a fresh Sink through
+ *  the callback.
+ *
+ *  Changes are picked up by poll(), e.g. once per frame, which does not
+ *  block. Uses inotify on Linux and compares modification times elsewhere.
+ *
+ *  @note: callbacks run on the thread calling poll(). A shader that fails to
+ *  compile keeps whatever Sink it had and is retried on its next change.
+ */
+class Watcher final {
+public:
+  using Callback =
+      std::function<void(const std::filesystem::path &shader,
+                         std::unique_ptr<compilation::Sink> sink)>;
+
+  /*
+   *  @note: called from the pool's threads. A rebuild only replaces the last
+   *  good one if the sink's succeeded() holds, i.e. every stage compiled.
+   */
+  using MakeSink = std::function<std::unique_ptr<compilation::Sink>()>;
+
+private:
+  struct Shader {
+    std::filesystem::path path;
+
+    //  identities of the shader itself and of everything it includes
+    std::vector<std::string> files;
+  };
+
+  VkDevice device;
+  Callback callback;
+  compilation::Profile profile;
+  WorkerPool &pool;
+  MakeSink makeSink;
+  DiskSourceProvider disk;
+
+  std::vector<Shader> shaders;
+  std::unordered_map<std::string, std::unordered_set<size_t>> dependents;
+
+#if defined(__linux__)
+  int fd = -1;
+  std::unordered_map<int, std::filesystem::path> directories;
+  std::unordered_map<std::string, int> watches;
+#else
+  std::unordered_map<std::string, std::filesystem::file_time_type> times;
+#endif
+
+public:
+  Watcher(const VkDevice device, Callback callback,
+          const compilation::Profile profile = compilation::Profile::Fast,
+          WorkerPool &pool = WorkerPool::shared(),
+          MakeSink makeSink =
+              [] { return std::make_unique<compilation::DefaultSink>(); })
+      : device(device), callback(std::move(callback)), profile(profile),
+        pool(pool), makeSink(std::move(makeSink)) {
+#if defined(__linux__)
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+      error("[watch] failed to start watching: {}", std::strerror(errno));
+    }
+#endif
+  }
+
+  ~Watcher() {
+#if defined(__linux__)
+    if (fd >= 0) {
+      ::close(fd);
+    }
+#endif
+  }
+
+  Watcher(const Watcher &) = delete;
+  Watcher &operator=(const Watcher &) = delete;
+
+public:
+  //  @note: compiles the shader right away, the callback gets its first Sink
+  bool watch(const std::filesystem::path &shader) {
+    shaders.push_back(Shader{shader, {}});
+    return rebuild({shaders.size() - 1}) == 1;
+  }
+
+  //  @note: returns how many shaders were rebuilt
+  size_t poll() {
+    const auto changed = changes();
+    if (changed.empty()) {
+      return 0;
+    }
+
+    //  @note: parsed copies of the changed files, and of every include
+    //  reaching them, are never used again
+    IncludeCache::shared().evict(changed);
+
+    std::unordered_set<size_t> affected;
+    for (const auto &file : changed) {
+      if (const auto it = dependents.find(file); it != dependents.end()) {
+        affected.insert(it->second.begin(), it->second.end());
+      }
+    }
+
+    if (affected.empty()) {
+      return 0;
+    }
+
+    std::vector<size_t> indices{affected.begin(), affected.end()};
+    std::ranges::sort(indices);
+
+    return rebuild(indices);
+  }
+
+  [[nodiscard]] size_t size() const { return shaders.size(); }
+
+private:
+  size_t rebuild(const std::vector<size_t> &indices) {
+    struct Rebuilt {
+      std::unique_ptr<compilation::Sink> sink;
+      Optional<compilation::Output> output;
+    };
+
+    //  @note: a fresh resolver reads the files again. Includes that did not
+    //  change, nested includes included, still come from the include cache
+    const auto resolver = std::make_shared<IncludeResolver>();
+
+    std::vector<Rebuilt> rebuilt(indices.size());
+    std::vector<WorkerPool::Task<void>> pending;
+    pending.reserve(indices.size());
+
+    for (size_t i = 0; i < indices.size(); i++) {
+      pending.push_back(
+          pool.submit([this, &result = rebuilt[i],
+                       &path = shaders[indices[i]].path, &resolver] {
+            result.sink = makeSink();
+            result.output =
+                compilation::compile(path, *result.sink, device, resolver,
+                                     Execution::Serial, profile);
+          }));
+    }
+
+    for (auto &job : pending) {
+      pool.wait(job);
+    }
+
+    size_t succeeded = 0;
+    for (size_t i = 0; i < indices.size(); i++) {
+      auto &shader = shaders[indices[i]];
+      auto &[sink, output] = rebuilt[i];
+
+      //  @note: a stage that failed, the fragment one too, fails the rebuild
+      if (!output.has_value() || !sink->succeeded()) {
+        error("[watch] failed to rebuild {}", shader.path.c_str());
+        sink->unload(device);
+
+        //  @note: keep the includes of the last good build, but always
+        //  notice the shader itself being fixed
+        auto files = shader.files;
+        if (files.empty()) {
+          files.push_back(disk.identity(shader.path));
+        }
+
+        track(indices[i], std::move(files));
+        continue;
+      }
+
+      std::vector<std::string> files{disk.identity(shader.path)};
+      files.insert(files.end(), output->includes.begin(),
+                   output->includes.end());
+      track(indices[i], std::move(files));
+
+      callback(shader.path, std::move(sink));
+      succeeded++;
+    }
+
+    return succeeded;
+  }
+
+  void track(const size_t index, std::vector<std::string> files) {
+    for (const auto &file : shaders[index].files) {
+      dependents[file].erase(index);
+    }
+
+    shaders[index].files = std::move(files);
+    for (const auto &file : shaders[index].files) {
+      dependents[file].insert(index);
+      observe(file);
+    }
+  }
+
+#if defined(__linux__)
+  //  @note: watches directories, editors often save by renaming a new file
+  //  over the old one, which a watch on the file itself would lose
+  void observe(const std::filesystem::path &file) {
+    const auto directory = file.parent_path();
+    if (fd < 0 || watches.contains(directory.native())) {
+      return;
+    }
+
+    const int wd = inotify_add_watch(fd, directory.c_str(),
+                                     IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (wd < 0) {
+      error("[watch] failed to watch {}: {}", directory.c_str(),
+            std::strerror(errno));
+      return;
+    }
+
+    watches.emplace(directory.native(), wd);
+    directories.emplace(wd, directory);
+  }
+
+  [[nodiscard]] std::unordered_set<std::string> changes() {
+    std::unordered_set<std::string> changed;
+    if (fd < 0) {
+      return changed;
+    }
+
+    alignas(inotify_event) char buffer[4096];
+    while (true) {
+      const auto size = ::read(fd, buffer, sizeof(buffer));
+      if (size <= 0) {
+        break;
+      }
+
+      for (ssize_t at = 0; at < size;) {
+        const auto *event =
+            reinterpret_cast<const inotify_event *>(buffer + at);
+        at += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+        //  @note: events were dropped, anything may have changed
+        if (event->mask & IN_Q_OVERFLOW) {
+          for (const auto &entry : dependents) {
+            changed.insert(entry.first);
+          }
+
+          continue;
+        }
+
+        const auto it = directories.find(event->wd);
+        if (it == directories.end() || event->len == 0) {
+          continue;
+        }
+
+        changed.insert(disk.identity(it->second / event->name));
+      }
+    }
+
+    return changed;
+  }
+#else
+  void observe(const std::string &file) {
+    if (times.contains(file)) {
+      return;
+    }
+
+    std::error_code ec;
+    times.emplace(file, std::filesystem::last_write_time(file, ec));
+  }
+
+  [[nodiscard]] std::unordered_set<std::string> changes() {
+    std::unordered_set<std::string> changed;
+
+    for (auto &[file, time] : times) {
+      std::error_code ec;
+      const auto current = std::filesystem::last_write_time(file, ec);
+      if (!ec && current != time) {
+        time = current;
+        changed.insert(file);
+      }
+    }
+
+    return changed;
+  }
+#endif
+};
+
+} // namespace ryuko
@@ -0,0 +1,90 @@
+#include "test.hpp"
+
+//  a broken `if` becomes Unknown as a whole, its body does not absorb the
+//  error
+TEST(enclosingStatementFailure) {
+  const std::string_view body = "\n    if x) a = 1;\n    b = 2;\n}";
+  const auto ast = ryuko::Ast::parse(body);
+
+  const auto first = ast.child(ast.root, 0);
+  const auto second = ast.child(ast.root, 1);
+
+  CHECK(first != ryuko::Ast::None &&
+        ast[first].kind == ryuko::Ast::Kind::Unknown);
+  CHECK(first != ryuko::Ast::None &&
+        ryuko::Ast::span(ast[first], body) == "if x) a = 1;");
+  CHECK(second != ryuko::Ast::None &&
+        ast[second].kind == ryuko::Ast::Kind::Expression);
+}
+
+namespace {
+
+//  the fragment stage of a shader whose frag() has the given body
+std::string fragment(const std::string_view body) {
+  const auto source = fmt::format(R"(#version 450
+
+varying vec4 Position;
+
+vec4 vert() {{
+    return Position;
+}}
+
+vec4 frag() {{{}}}
+)",
+                                  body);
+
+  ryuko::transpilation::MemorySink sink;
+  if (!ryuko::transpilation::transpile(source, "frag.glsl", sink)
+           .has_value()) {
+    return {};
+  }
+
+  return sink.fragmentCode;
+}
+
+bool contains(const std::string_view code, const std::string_view text) {
+  return code.find(text) != std::string_view::npos;
+}
+
+} // namespace
+
+//  an early return keeps leaving the function, the last one falls through
+TEST(multipleReturns) {
+  const auto code = fragment(R"(
+    if (Position.x > 0.0) {
+        return vec4(1.0);
+    }
+    return vec4(0.0);
+)");
+
+  CHECK(contains(code, "{ ryuko_outColor = vec4(1.0); return; }"));
+  CHECK(contains(code, "ryuko_outColor = vec4(0.0);"));
+  CHECK(!contains(code, "return vec4"));
+}
+
+//  a return nested in loops and branches is rewritten where it is
+TEST(nestedReturn) {
+  const auto code = fragment(R"(
+    for (int i = 0; i < 4; i++) {
+        if (i == 2)
+            return vec4(float(i));
+    }
+    return vec4(0.0);
+)");
+
+  CHECK(contains(code, "if (i == 2)\n            { ryuko_outColor = "
+                       "vec4(float(i)); return; }"));
+  CHECK(!contains(code, "return vec4"));
+}
+
+//  a return in a statement the AST kept as Unknown is still rewritten
+TEST(recoveredStatementReturn) {
+  const auto code = fragment(R"(
+    if Position.x > 0.0) return vec4(1.0);
+    return vec4(0.0);
+)");
+
+  CHECK(contains(code, "{ ryuko_outColor = vec4(1.0); return; }"));
+  CHECK(contains(code, "ryuko_outColor = vec4(0.0);"));
+  CHECK(!contains(code, "return vec4"));
+}
@@ -0,0 +1,62 @@
+#include "test.hpp"
+
+namespace {
+
+using ryuko::compilation::Output;
+using ryuko::compilation::Pending;
+
+//  a coroutine that starts right away and is never awaited itself
+struct Detached {
+  struct promise_type {
+    Detached get_return_object() { return {}; }
+    std::suspend_never initial_suspend() { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+Detached await(Pending &pending, std::atomic<int> &resumed) {
+  const auto output = co_await pending;
+  resumed = output.has_value() ? 1 : 2;
+}
+
+} // namespace
+
+//  a job that throws still finishes, with no output, and resumes the
+//  coroutine awaiting it
+TEST(asyncThrowingJob) {
+  //  @note: one thread, kept busy until the coroutine is suspended
+  ryuko::WorkerPool pool{1};
+  std::promise<void> release;
+  auto gate = pool.submit([opened = release.get_future().share()] {
+    opened.wait();
+  });
+
+  auto pending =
+      Pending::start(pool, []() -> ryuko::Optional<Output> {
+        throw std::runtime_error{"broken"};
+      });
+
+  std::atomic<int> resumed = 0;
+  await(pending, resumed);
+  CHECK(resumed == 0);
+
+  release.set_value();
+  pool.wait(gate);
+
+  CHECK(!pending.wait().has_value());
+  CHECK(pending.ready());
+  CHECK(resumed == 2);
+}
+
+//  a handle that was never started has nothing to wait for
+TEST(asyncInvalidPending) {
+  Pending none;
+  CHECK(!none.valid() && !none.ready());
+  CHECK(!none.wait().has_value());
+
+  std::atomic<int> resumed = 0;
+  await(none, resumed);
+  CHECK(resumed == 2);
+}
@@ -0,0 +1,71 @@
+#include "test.hpp"
+
+//  a shader whose fragment stage fails is not compiled, even though its
+//  vertex stage is, one without a fragment stage is, and a missing one
+//  fails without holding up the rest
+TEST(brokenFragmentFails) {
+  const ryuko::test::Scratch scratch{"broken-fragment-fails"};
+
+  const std::vector<std::filesystem::path> paths{
+      scratch.write("good.glsl", ryuko::test::BothStages),
+      scratch.write("broken.glsl", ryuko::test::BrokenFragment),
+      scratch.write("vertex.glsl", ryuko::test::VertexOnly),
+      scratch.path("missing.glsl"),
+  };
+
+  const auto results = ryuko::compilation::compileAll(
+      paths, std::make_shared<ryuko::IncludeResolver>(),
+      ryuko::WorkerPool::shared(), ryuko::Execution::Serial,
+      ryuko::compilation::Profile::Fast);
+
+  CHECK(results.size() == 4);
+  CHECK(results[0].succeeded());
+  CHECK(results[0].sink.spirv.fragmentCode.has_value());
+
+  CHECK(!results[1].succeeded());
+  CHECK(results[1].sink.spirv.vertexCode.has_value());
+  CHECK(!results[1].sink.spirv.fragmentCode.has_value());
+
+  CHECK(results[2].succeeded());
+
+  CHECK(!results[3].succeeded());
+  CHECK(!results[3].output.has_value());
+}
+
+//  the same for a sink that creates the shader modules
+TEST(brokenFragmentSinkFails) {
+  const ryuko::test::Scratch scratch{"broken-fragment-sink-fails"};
+
+  ryuko::compilation::DefaultSink sink;
+  const auto output = ryuko::compilation::compile(
+      scratch.write("broken.glsl", ryuko::test::BrokenFragment), sink,
+      VK_NULL_HANDLE);
+
+  CHECK(output.has_value());
+  CHECK(sink.hasVertexCode());
+  CHECK(!sink.hasFragmentCode());
+  CHECK(!sink.succeeded());
+
+  sink.unload(VK_NULL_HANDLE);
+}
+
+//  transpiling a batch keeps the order of its paths, failures included
+TEST(transpileBatch) {
+  const ryuko::test::Scratch scratch{"transpile-batch"};
+
+  const std::vector<std::filesystem::path> paths{
+      scratch.write("vertex.glsl", ryuko::test::VertexOnly),
+      scratch.path("missing.glsl"),
+      scratch.write("textured.glsl", ryuko::test::Textured),
+  };
+
+  const auto results = ryuko::transpilation::transpileAll(paths);
+
+  CHECK(results.size() == 3);
+  CHECK(results[0].output.has_value() && results[0].sink.fragmentCode.empty());
+  CHECK(!results[1].output.has_value());
+  CHECK(results[2].output.has_value() &&
+        !results[2].sink.fragmentCode.empty());
+  CHECK(ryuko::test::hasUniform(results[2].sink, "albedo"));
+  CHECK(results[2].path == paths[2]);
+}
@@ -0,0 +1,104 @@
+#include "test.hpp"
+
+namespace {
+
+using ryuko::Bundle;
+using ryuko::test::patched;
+
+bool loads(std::string blob) {
+  return Bundle::load(ryuko::SourceFile{std::move(blob)}) != nullptr;
+}
+
+} // namespace
+
+//  what is packed loads back as compiled, shaders that failed are left out
+TEST(bundleRoundTrip) {
+  const ryuko::test::Scratch scratch{"bundle-round-trip"};
+
+  const std::vector<std::filesystem::path> paths{
+      scratch.write("textured.glsl", ryuko::test::Textured),
+      scratch.write("vertex.glsl", ryuko::test::VertexOnly),
+      scratch.write("broken.glsl", ryuko::test::BrokenFragment),
+  };
+
+  const auto compiled = ryuko::compilation::compileAll(
+      paths, std::make_shared<ryuko::IncludeResolver>(),
+      ryuko::WorkerPool::shared(), ryuko::Execution::Serial,
+      ryuko::compilation::Profile::Fast);
+
+  const auto blob = ryuko::Bundle::pack(compiled, scratch.path(""));
+
+  //  @note: the same results always pack to the same bytes
+  CHECK(ryuko::Bundle::pack(compiled, scratch.path("")) == blob);
+
+  const auto file = scratch.write("shaders.ryub", blob);
+
+  const auto bundle = ryuko::Bundle::open(file);
+  CHECK(bundle);
+  if (!bundle) {
+    return;
+  }
+
+  //  @note: a few hundred bytes, mapped all the same
+  CHECK(bundle->isMapped());
+  CHECK(bundle->size() == 2);
+  CHECK(!bundle->find("broken.glsl").has_value());
+
+  const auto textured = bundle->find("textured.glsl");
+  CHECK(textured.has_value());
+  if (textured.has_value()) {
+    const auto &spirv = compiled[0].sink.spirv;
+    CHECK(std::ranges::equal(textured->vertex, spirv.vertexCode.value()));
+    CHECK(std::ranges::equal(textured->fragment, spirv.fragmentCode.value()));
+  }
+
+  ryuko::compilation::DefaultSink sink;
+  CHECK(bundle->load("textured.glsl", sink, VK_NULL_HANDLE));
+  CHECK(sink.hasVertexCode() && sink.hasFragmentCode());
+  CHECK(sink.uniforms.size() == 1);
+  CHECK(!sink.uniforms.empty() && sink.uniforms[0].accessor == "albedo" &&
+        sink.uniforms[0].set == 0 && sink.uniforms[0].binding == 0 &&
+        sink.uniforms[0].value.arrayLength == 0);
+  sink.unload(VK_NULL_HANDLE);
+
+  CHECK(bundle->load("vertex.glsl", sink, VK_NULL_HANDLE));
+  CHECK(sink.hasVertexCode() && !sink.hasFragmentCode());
+  sink.unload(VK_NULL_HANDLE);
+
+  CHECK(!bundle->load("broken.glsl", sink, VK_NULL_HANDLE));
+}
+
+//  a header, index or entry that does not add up is rejected
+TEST(bundleRejectsCorruption) {
+  using Header = Bundle::Header;
+  using Entry = Bundle::Entry;
+  using Range = Bundle::Range;
+
+  const ryuko::test::Scratch scratch{"bundle-rejects-corruption"};
+
+  const auto compiled = ryuko::compilation::compileAll(
+      std::vector{scratch.write("vertex.glsl", ryuko::test::VertexOnly)},
+      std::make_shared<ryuko::IncludeResolver>(), ryuko::WorkerPool::shared(),
+      ryuko::Execution::Serial, ryuko::compilation::Profile::Fast);
+
+  const auto blob = Bundle::pack(compiled, scratch.path(""));
+  CHECK(loads(blob));
+
+  //  header
+  CHECK(!loads(patched(blob, offsetof(Header, magic), 'X')));
+  CHECK(!loads(patched(blob, offsetof(Header, version), Bundle::Version + 1)));
+  CHECK(!loads(blob.substr(0, sizeof(Header) - 1)));
+
+  //  index
+  CHECK(!loads(patched(blob, offsetof(Header, count), uint32_t{2})));
+  CHECK(!loads(blob.substr(0, sizeof(Header) + sizeof(Entry) - 1)));
+  CHECK(!loads(blob.substr(0, blob.size() - 1)));
+
+  //  entry ranges
+  constexpr auto vertex = sizeof(Header) + offsetof(Entry, vertex);
+  CHECK(!loads(patched(blob, vertex + offsetof(Range, offset),
+                       uint64_t{blob.size()})));
+  CHECK(!loads(patched(blob, vertex + offsetof(Range, offset), uint64_t{2})));
+  CHECK(!loads(patched(blob, vertex + offsetof(Range, size),
+                       std::numeric_limits<uint64_t>::max())));
+}
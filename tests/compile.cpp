@@ -0,0 +1,30 @@
+#include "test.hpp"
+
+namespace {
+
+//  a sink written before write() took WriteOptions
+struct LegacySink final : ryuko::compilation::Sink {
+  size_t writes = 0;
+
+public:
+  void write([[maybe_unused]] const std::filesystem::path &path,
+             [[maybe_unused]] const ryuko::Emitter::Output &code,
+             [[maybe_unused]] const VkDevice device) override {
+    writes++;
+  }
+};
+
+} // namespace
+
+//  a sink overriding only the old write() is still written to
+TEST(legacySinkWrite) {
+  const ryuko::test::Scratch scratch{"legacy-sink-write"};
+
+  LegacySink sink;
+  const auto output = ryuko::compilation::compile(
+      scratch.write("vertex.glsl", ryuko::test::VertexOnly),
+      sink, VK_NULL_HANDLE);
+
+  CHECK(output.has_value());
+  CHECK(sink.writes == 1);
+}
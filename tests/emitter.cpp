@@ -0,0 +1,38 @@
+#include "test.hpp"
+
+//  every overload frag() calls is declared and emitted, not just the first
+TEST(emitterOverloads) {
+  constexpr std::string_view source = R"(#version 450
+
+varying vec4 Position;
+
+float shade(float v) {
+    return v;
+}
+
+float shade(vec2 v) {
+    return shade(v.x) + v.y;
+}
+
+vec4 vert() {
+    return Position;
+}
+
+vec4 frag() {
+    return vec4(shade(1.0), shade(vec2(1.0)), 0.0, 1.0);
+}
+)";
+
+  ryuko::transpilation::MemorySink sink;
+  CHECK(ryuko::transpilation::transpile(source, "overloads.glsl", sink)
+            .has_value());
+
+  const std::string_view fragment = sink.fragmentCode;
+  CHECK(fragment.find("float shade(float v);") != std::string_view::npos);
+  CHECK(fragment.find("float shade(vec2 v);") != std::string_view::npos);
+  CHECK(fragment.find("float shade(float v) {") != std::string_view::npos);
+  CHECK(fragment.find("float shade(vec2 v) {") != std::string_view::npos);
+
+  //  @note: vert() calls neither
+  CHECK(sink.vertexCode.find("shade") == std::string::npos);
+}
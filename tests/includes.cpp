@@ -0,0 +1,108 @@
+#include "test.hpp"
+
+namespace {
+
+using ryuko::test::hasUniform;
+
+bool includes(const ryuko::transpilation::Output &output,
+              const std::filesystem::path &file) {
+  return std::ranges::find(output.includes,
+                           std::filesystem::weakly_canonical(file).string()) !=
+         output.includes.end();
+}
+
+} // namespace
+
+//  a cached include must not outlive an edit to a file it includes
+TEST(nestedIncludeEdit) {
+  const ryuko::test::Scratch scratch{"nested-include-edit"};
+  const auto main = ryuko::test::nestedIncludes(scratch);
+
+  ryuko::transpilation::MemorySink before;
+  const auto first = ryuko::transpilation::transpile(main, before);
+  CHECK(first.has_value());
+  CHECK(hasUniform(before, "oldTex"));
+
+  scratch.write("b.glsl", R"(#include "c.glsl"
+
+layout (set = 0, binding = 0) uniform sampler2D newTex;
+)");
+
+  ryuko::transpilation::MemorySink after;
+  const auto second = ryuko::transpilation::transpile(
+      main, after, std::make_shared<ryuko::IncludeResolver>());
+  CHECK(second.has_value());
+  CHECK(hasUniform(after, "newTex"));
+  CHECK(!hasUniform(after, "oldTex"));
+  CHECK(second.has_value() && includes(*second, scratch.path("c.glsl")));
+}
+
+//  an include cycle stops where it closes instead of recursing, and what was
+//  parsed with it cut short is not cached
+TEST(includeCycle) {
+  const ryuko::test::Scratch scratch{"include-cycle"};
+
+  const auto main = scratch.write("main.glsl", R"(#version 450
+#include "a.glsl"
+
+varying vec4 Position;
+
+vec4 vert() {
+    return Position;
+}
+)");
+  scratch.write("a.glsl", "#include \"b.glsl\"\n");
+  scratch.write("b.glsl", R"(#include "a.glsl"
+
+layout (set = 0, binding = 0) uniform sampler2D cyclicTex;
+)");
+
+  ryuko::transpilation::MemorySink cyclic;
+  const auto output = ryuko::transpilation::transpile(main, cyclic);
+  CHECK(output.has_value());
+  CHECK(ryuko::test::hasUniform(cyclic, "cyclicTex"));
+  CHECK(output.has_value() && output->includes.size() == 2);
+
+  //  @note: same content for a, only b changes
+  scratch.write("b.glsl",
+                "layout (set = 0, binding = 0) uniform sampler2D fixedTex;\n");
+
+  ryuko::transpilation::MemorySink fixed;
+  CHECK(ryuko::transpilation::transpile(main, fixed).has_value());
+  CHECK(ryuko::test::hasUniform(fixed, "fixedTex"));
+  CHECK(!ryuko::test::hasUniform(fixed, "cyclicTex"));
+}
+
+//  a file reached through several includes is parsed and included once
+TEST(includeOnce) {
+  const ryuko::test::Scratch scratch{"include-once"};
+
+  const auto main = scratch.write("main.glsl", R"(#version 450
+#include "a.glsl"
+#include "b.glsl"
+
+varying vec4 Position;
+
+vec4 vert() {
+    return passThrough(Position);
+}
+)");
+  scratch.write("a.glsl", "#include \"common.glsl\"\n");
+  scratch.write("b.glsl", "#include \"common.glsl\"\n");
+  scratch.write("common.glsl", R"(layout (set = 0, binding = 0) uniform sampler2D albedo;
+
+vec4 passThrough(vec4 v) {
+    return v;
+}
+)");
+
+  ryuko::transpilation::MemorySink sink;
+  const auto output = ryuko::transpilation::transpile(main, sink);
+  CHECK(output.has_value());
+  CHECK(sink.uniforms.size() == 1);
+  CHECK(output.has_value() &&
+        std::ranges::count(output->includes,
+                           std::filesystem::weakly_canonical(
+                               scratch.path("common.glsl"))
+                               .string()) == 1);
+}
@@ -0,0 +1,17 @@
+#include "test.hpp"
+
+int main() {
+  size_t failures = 0;
+
+  for (const auto &[name, run] : ryuko::test::cases()) {
+    bool failed = false;
+    run(failed);
+
+    fmt::println("[{}] {}", failed ? "fail" : " ok ", name);
+    failures += failed;
+  }
+
+  fmt::println("{} of {} tests passed", ryuko::test::cases().size() - failures,
+               ryuko::test::cases().size());
+  return failures ? 1 : 0;
+}
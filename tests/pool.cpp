@@ -0,0 +1,24 @@
+#include "test.hpp"
+
+//  a thread outside the pool runs the task it waits for, and only that one
+TEST(poolExternalWait) {
+  ryuko::WorkerPool pool{1};
+
+  //  @note: keeps the only worker busy
+  std::promise<void> release;
+  auto gate = pool.submit([opened = release.get_future().share()] {
+    opened.wait();
+  });
+
+  std::atomic<bool> unrelatedRan = false;
+  auto unrelated = pool.submit([&unrelatedRan] { unrelatedRan = true; });
+  auto awaited = pool.submit([] { return std::this_thread::get_id(); });
+
+  CHECK(pool.wait(awaited) == std::this_thread::get_id());
+  CHECK(!unrelatedRan);
+
+  release.set_value();
+  pool.wait(gate);
+  pool.wait(unrelated);
+  CHECK(unrelatedRan);
+}
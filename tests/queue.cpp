@@ -0,0 +1,147 @@
+#include "test.hpp"
+
+namespace {
+
+using ryuko::compilation::CompileQueue;
+
+//  the shaders written, in the order the queue ran them
+struct Recorder final : ryuko::compilation::Sink {
+  static inline std::mutex mutex;
+  static inline std::vector<std::string> order;
+
+public:
+  void write(const std::filesystem::path &path,
+             [[maybe_unused]] const ryuko::Emitter::Output &code,
+             [[maybe_unused]] const VkDevice device,
+             [[maybe_unused]] const ryuko::compilation::WriteOptions &options)
+      override {
+    std::lock_guard lock{mutex};
+    order.push_back(path.stem().string());
+  }
+};
+
+bool finished(const CompileQueue::Ticket &ticket) {
+  const auto state = ticket.state();
+  return state == CompileQueue::State::Done ||
+         state == CompileQueue::State::Cancelled;
+}
+
+} // namespace
+
+//  identical submissions share a job, priorities decide the order, and a
+//  job runs unless every ticket on it gave up
+TEST(queuePriorityDedupCancel) {
+  const ryuko::test::Scratch scratch{"queue-priority-dedup-cancel"};
+
+  const auto shader = [&scratch](const std::string_view name) {
+    return scratch.write(fmt::format("{}.glsl", name),
+                         ryuko::test::VertexOnly);
+  };
+
+  //  @note: one thread, kept busy until every job is queued
+  ryuko::WorkerPool pool{1};
+  std::promise<void> release;
+  auto gate = pool.submit([opened = release.get_future().share()] {
+    opened.wait();
+  });
+
+  Recorder::order.clear();
+  CompileQueue queue{VK_NULL_HANDLE, nullptr, pool, ryuko::Execution::Serial,
+                     [] { return std::make_unique<Recorder>(); }};
+
+  auto a = queue.submit(shader("a"), 0);
+  auto b = queue.submit(shader("b"), 0);
+  auto sharedA = queue.submit(scratch.path("a.glsl"), 5);
+  auto c = queue.submit(shader("c"), 1);
+  auto d = queue.submit(shader("d"), 2);
+  auto e = queue.submit(shader("e"), 0);
+
+  CHECK(queue.size() == 5);
+
+  b.setPriority(10);
+
+  //  a is still wanted by sharedA
+  a.cancel();
+  CHECK(a.state() == CompileQueue::State::Queued);
+
+  c.cancel();
+  CHECK(c.state() == CompileQueue::State::Cancelled);
+  CHECK(queue.size() == 4);
+
+  //  moving leaves nothing behind to cancel
+  auto movedB = std::move(b);
+  CHECK(!b.valid());
+  b.cancel();
+  CHECK(movedB.state() == CompileQueue::State::Queued);
+
+  //  assigning over a ticket gives up on its job
+  d = std::move(e);
+  CHECK(!e.valid());
+  CHECK(queue.size() == 3);
+
+  release.set_value();
+  pool.wait(gate);
+
+  while (!finished(sharedA) || !finished(movedB) || !finished(d)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds{1});
+  }
+
+  CHECK(sharedA.ready() && a.ready());
+  CHECK(movedB.ready() && d.ready());
+  CHECK((Recorder::order == std::vector<std::string>{"b", "a", "e"}));
+}
+
+//  a ticket moved from, or never submitted, holds no job and reads as
+//  cancelled
+TEST(queueInvalidTicket) {
+  const ryuko::test::Scratch scratch{"queue-invalid-ticket"};
+
+  const auto shader = scratch.write("a.glsl", ryuko::test::VertexOnly);
+
+  CompileQueue queue{VK_NULL_HANDLE, nullptr, ryuko::WorkerPool::shared(),
+                     ryuko::Execution::Serial,
+                     [] { return std::make_unique<Recorder>(); }};
+
+  const auto inert = [&failed](CompileQueue::Ticket &ticket) {
+    CHECK(!ticket.valid());
+    CHECK(ticket.state() == CompileQueue::State::Cancelled);
+    CHECK(!ticket.ready());
+
+    ticket.setPriority(10);
+    ticket.cancel();
+
+    CHECK(ticket.wait() == CompileQueue::State::Cancelled);
+    CHECK(ticket.sink() == nullptr);
+    CHECK(!ticket.output().has_value());
+  };
+
+  auto ticket = queue.submit(shader);
+  auto moved = std::move(ticket);
+  inert(ticket);
+
+  CompileQueue::Ticket unsubmitted;
+  inert(unsubmitted);
+
+  CHECK(moved.wait() == CompileQueue::State::Done);
+  CHECK(moved.sink() != nullptr);
+}
+
+//  a shader that fails to compile, or is missing, still finishes its job
+TEST(queueFailedCompile) {
+  const ryuko::test::Scratch scratch{"queue-failed-compile"};
+
+  CompileQueue queue{
+      VK_NULL_HANDLE, nullptr, ryuko::WorkerPool::shared(),
+      ryuko::Execution::Serial,
+      [] { return std::make_unique<ryuko::compilation::SpirvSink>(); }};
+
+  auto broken =
+      queue.submit(scratch.write("broken.glsl", ryuko::test::BrokenFragment));
+  auto missing = queue.submit(scratch.path("missing.glsl"));
+
+  CHECK(broken.wait() == CompileQueue::State::Done);
+  CHECK(broken.sink() && !broken.sink()->succeeded());
+
+  CHECK(missing.wait() == CompileQueue::State::Done);
+  CHECK(!missing.output().has_value());
+}
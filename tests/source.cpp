@@ -0,0 +1,42 @@
+#include "test.hpp"
+
+//  a source rewritten in place while open keeps the content it was read with
+TEST(sourceRewrittenInPlace) {
+  const ryuko::test::Scratch scratch{"source-rewritten-in-place"};
+
+  const auto path = scratch.write("main.glsl", "#version 450\n");
+  const auto source = ryuko::SourceFile::open(path);
+  CHECK(source.has_value() && !source->isMapped());
+
+  //  @note: truncates the same inode, as an editor saving in place does
+  scratch.write("main.glsl", "");
+  CHECK(source.has_value() && source->content() == "#version 450\n");
+
+  const std::string large(ryuko::SourceFile::MapThreshold, 'x');
+  const auto mapped = ryuko::SourceFile::open(scratch.write("large", large));
+  CHECK(mapped.has_value() && mapped->content() == large);
+
+  const auto always = ryuko::SourceFile::open(
+      scratch.write("small", "#version 450\n"), ryuko::SourceFile::Map::Always);
+  CHECK(always.has_value() && always->isMapped());
+  CHECK(always.has_value() && always->content() == "#version 450\n");
+}
+
+//  a file with no size up front, such as a pipe, is read to its end
+TEST(sourceFromPipe) {
+  const ryuko::test::Scratch scratch{"source-from-pipe"};
+
+  const auto path = scratch.path("pipe");
+  CHECK(mkfifo(path.c_str(), 0600) == 0);
+
+  const std::string content(10000, 'x');
+  std::thread writer{[&path, &content] {
+    std::ofstream out(path, std::ios::binary);
+    out.write(content.data(), static_cast<std::streamsize>(content.size()));
+  }};
+
+  const auto source = ryuko::SourceFile::open(path);
+  writer.join();
+
+  CHECK(source.has_value() && source->content() == content);
+}
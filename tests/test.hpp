@@ -0,0 +1,172 @@
+#pragma once
+
+#include <ryuko/ryuko.hpp>
+
+namespace ryuko::test {
+
+struct Case {
+  std::string_view name;
+  void (*run)(bool &failed);
+};
+
+[[nodiscard]] inline std::vector<Case> &cases() {
+  static std::vector<Case> registered;
+  return registered;
+}
+
+struct Register {
+  Register(const std::string_view name, void (*run)(bool &failed)) {
+    cases().push_back(Case{name, run});
+  }
+};
+
+//  a directory of its own for the files of one test, removed afterwards
+class Scratch final {
+  std::filesystem::path root;
+
+public:
+  explicit Scratch(const std::string_view name)
+      : root(std::filesystem::temp_directory_path() /
+             fmt::format("ryuko-{}-{}", name,
+                         std::hash<std::thread::id>{}(
+                             std::this_thread::get_id()))) {
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root);
+  }
+
+  ~Scratch() {
+    std::error_code ec;
+    std::filesystem::remove_all(root, ec);
+  }
+
+  Scratch(const Scratch &) = delete;
+  Scratch &operator=(const Scratch &) = delete;
+
+public:
+  [[nodiscard]] std::filesystem::path path(const std::string_view name) const {
+    return root / name;
+  }
+
+  std::filesystem::path write(const std::string_view name,
+                              const std::string_view content) const {
+    const auto file = path(name);
+    std::ofstream out(file, std::ios::binary | std::ios::trunc);
+    out.write(content.data(), static_cast<std::streamsize>(content.size()));
+    return file;
+  }
+};
+
+//  a copy of blob with the value at offset overwritten
+template <typename T>
+[[nodiscard]] std::string patched(std::string blob, const size_t offset,
+                                  const T value) {
+  std::memcpy(blob.data() + offset, &value, sizeof(value));
+  return blob;
+}
+
+//  a shader with a vertex stage only
+inline constexpr std::string_view VertexOnly = R"(#version 450
+
+varying vec4 Position;
+
+vec4 vert() {
+    return Position;
+}
+)";
+
+//  a shader with both stages
+inline constexpr std::string_view BothStages = R"(#version 450
+
+varying vec4 Position;
+
+vec4 vert() {
+    return Position;
+}
+
+vec4 frag() {
+    return vec4(1.0);
+}
+)";
+
+//  both stages and a sampler to reflect
+inline constexpr std::string_view Textured = R"(#version 450
+
+layout (set = 0, binding = 0) uniform sampler2D albedo;
+
+varying vec4 Position;
+
+vec4 vert() {
+    return Position;
+}
+
+vec4 frag() {
+    return vec4(1.0);
+}
+)";
+
+//  both stages, the fragment one does not compile
+inline constexpr std::string_view BrokenFragment = R"(#version 450
+
+varying vec4 Position;
+
+vec4 vert() {
+    return Position;
+}
+
+vec4 frag() {
+#error broken
+    return vec4(1.0);
+}
+)";
+
+/*
+ *  main.glsl includes a.glsl, which includes b.glsl declaring the sampler
+ *  `oldTex`. c.glsl is included by nothing yet. Returns main.glsl.
+ */
+inline std::filesystem::path nestedIncludes(const Scratch &scratch) {
+  scratch.write("a.glsl", R"(#include "b.glsl"
+
+vec4 helper(vec4 v) {
+    return v;
+}
+)");
+  scratch.write("b.glsl",
+                "layout (set = 0, binding = 0) uniform sampler2D oldTex;\n");
+  scratch.write("c.glsl", R"(vec4 extra(vec4 v) {
+    return v;
+}
+)");
+
+  return scratch.write("main.glsl", R"(#version 450
+#include "a.glsl"
+
+varying vec4 Position;
+
+vec4 vert() {
+    return helper(Position);
+}
+)");
+}
+
+//  for transpilation and compilation sinks alike
+template <typename Sink>
+[[nodiscard]] bool hasUniform(const Sink &sink, const std::string_view name) {
+  return std::ranges::any_of(sink.uniforms, [name](const auto &uniform) {
+    return uniform.accessor == name;
+  });
+}
+
+} // namespace ryuko::test
+
+#define TEST(name)                                                             \
+  static void name(bool &failed);                                              \
+  static const ryuko::test::Register name##Registered{#name, name};            \
+  static void name([[maybe_unused]] bool &failed)
+
+#define CHECK(condition)                                                       \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      ryuko::error("{}:{}: check failed: {}", __FILE__, __LINE__, #condition); \
+      failed = true;                                                           \
+    }                                                                          \
+  } while (false)
@@ -0,0 +1,57 @@
+#include "test.hpp"
+
+//  a permutation whose fragment stage fails is not loaded without it
+TEST(variantBrokenFragment) {
+  const ryuko::test::Scratch scratch{"variant-broken-fragment"};
+
+  const auto good = ryuko::compilation::Variants::open(
+      scratch.write("good.glsl", ryuko::test::BothStages));
+  const auto broken = ryuko::compilation::Variants::open(
+      scratch.write("broken.glsl", ryuko::test::BrokenFragment));
+
+  CHECK(good && broken);
+  if (!good || !broken) {
+    return;
+  }
+
+  const ryuko::compilation::Defines defines{"LIT", "SHADOWS=1"};
+
+  ryuko::compilation::DefaultSink sink;
+  CHECK(good->load(defines, sink, VK_NULL_HANDLE).has_value());
+  CHECK(sink.hasVertexCode() && sink.hasFragmentCode());
+  sink.unload(VK_NULL_HANDLE);
+
+  CHECK(!broken->load(defines, sink, VK_NULL_HANDLE).has_value());
+  CHECK(!sink.hasVertexCode() && !sink.hasFragmentCode());
+
+  const auto variant = broken->find(defines);
+  CHECK(variant && !variant->succeeded());
+  CHECK(variant && variant->spirv.vertexCode.has_value());
+}
+
+//  a define that is not an identifier, or spans lines, builds nothing
+TEST(variantInvalidDefine) {
+  using ryuko::compilation::Defines;
+
+  const ryuko::test::Scratch scratch{"variant-invalid-define"};
+
+  const auto variants = ryuko::compilation::Variants::open(
+      scratch.write("shader.glsl", ryuko::test::BothStages));
+  CHECK(variants);
+  if (!variants) {
+    return;
+  }
+
+  for (const auto &defines : {Defines{"1BAD"}, Defines{"A-B"}, Defines{"=1"},
+                              Defines{"LIT", "X=a\nb"}}) {
+    CHECK(!ryuko::compilation::defineLines(defines).has_value());
+
+    ryuko::compilation::DefaultSink sink;
+    CHECK(!variants->load(defines, sink, VK_NULL_HANDLE).has_value());
+    CHECK(!sink.hasVertexCode() && !sink.hasFragmentCode());
+  }
+
+  const Defines valid{"_LIT2", "X=a b"};
+  CHECK(ryuko::compilation::defineLines(valid) ==
+        std::string{"#define _LIT2 \n#define X a b\n"});
+}
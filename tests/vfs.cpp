@@ -0,0 +1,113 @@
+#include "test.hpp"
+
+namespace {
+
+using ryuko::ArchiveSourceProvider;
+using ryuko::test::patched;
+
+constexpr std::string_view Main = R"(#version 450
+#include "lib/helper.glsl"
+
+varying vec4 Position;
+
+vec4 vert() {
+    return helper(Position);
+}
+)";
+
+constexpr std::string_view Helper = R"(layout (set = 0, binding = 0) uniform sampler2D albedo;
+
+vec4 helper(vec4 v) {
+    return v;
+}
+)";
+
+std::string archive() {
+  return ArchiveSourceProvider::pack({
+      {"main.glsl", std::string{Main}},
+      {"./lib/helper.glsl", std::string{Helper}},
+  });
+}
+
+bool transpiles(const std::shared_ptr<ryuko::SourceProvider> &provider) {
+  const auto resolver = std::make_shared<ryuko::IncludeResolver>(provider);
+
+  ryuko::transpilation::MemorySink sink;
+  if (!ryuko::transpilation::transpile("main.glsl", sink, resolver)
+           .has_value()) {
+    return false;
+  }
+
+  //  @note: the include was parsed, its uniform is reflected
+  return sink.uniforms.size() == 1 && sink.uniforms[0].accessor == "albedo";
+}
+
+} // namespace
+
+//  what is packed opens back under its normalized path, from memory and
+//  from disk, and resolves includes
+TEST(archiveRoundTrip) {
+  const auto loaded = ArchiveSourceProvider::load(ryuko::SourceFile{archive()});
+  CHECK(loaded && loaded->size() == 2);
+  if (!loaded) {
+    return;
+  }
+
+  const auto main = loaded->open("main.glsl");
+  const auto helper = loaded->open("lib/../lib/helper.glsl");
+  CHECK(main.has_value() && main->content() == Main);
+  CHECK(helper.has_value() && helper->content() == Helper);
+  CHECK(!loaded->open("missing.glsl").has_value());
+
+  CHECK(transpiles(loaded));
+
+  const ryuko::test::Scratch scratch{"archive-round-trip"};
+  const auto mounted =
+      ArchiveSourceProvider::mount(scratch.write("shaders.ryka", archive()));
+  CHECK(mounted && mounted->size() == 2);
+  CHECK(mounted && mounted->isMapped());
+  CHECK(!loaded->isMapped());
+  CHECK(mounted && transpiles(mounted));
+}
+
+//  an index or entry that reaches past the end of the blob is rejected
+TEST(archiveRejectsCorruption) {
+  using Header = ArchiveSourceProvider::Header;
+  using Entry = ArchiveSourceProvider::Entry;
+
+  const auto blob = archive();
+  const auto load = [](std::string bytes) {
+    return ArchiveSourceProvider::load(ryuko::SourceFile{std::move(bytes)});
+  };
+
+  CHECK(load(blob));
+
+  CHECK(!load(blob.substr(0, sizeof(Header) - 1)));
+  CHECK(!load(blob.substr(0, sizeof(Header) + sizeof(Entry))));
+  CHECK(!load(patched(blob, offsetof(Header, count), uint32_t{1000})));
+  CHECK(!load(patched(blob, 0, std::array{'X', 'Y', 'K', 'A'})));
+
+  const auto entry = sizeof(Header) + sizeof(Entry);
+  CHECK(!load(patched(blob, entry + offsetof(Entry, contentOffset),
+                      uint64_t{blob.size()})));
+  CHECK(!load(patched(blob, entry + offsetof(Entry, pathOffset),
+                      std::numeric_limits<uint64_t>::max())));
+
+  //  @note: offset and size each fit, their sum wraps around
+  CHECK(!load(patched(
+      patched(blob, entry + offsetof(Entry, contentOffset), uint64_t{8}),
+      entry + offsetof(Entry, contentSize),
+      std::numeric_limits<uint64_t>::max() - 7)));
+}
+
+//  a shader held in memory includes other files held in memory
+TEST(memoryProviderIncludes) {
+  const auto provider = std::make_shared<ryuko::MemorySourceProvider>();
+  provider->add("main.glsl", std::string{Main});
+  provider->add("lib/helper.glsl", std::string{Helper});
+
+  CHECK(transpiles(provider));
+
+  provider->remove("lib/helper.glsl");
+  CHECK(!transpiles(provider));
+}
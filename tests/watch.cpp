@@ -0,0 +1,103 @@
+#include "test.hpp"
+
+using ryuko::test::hasUniform;
+
+//  editing a nested include rebuilds with its new content, and an include
+//  it newly pulls in is watched from then on
+TEST(watchNestedIncludeEdit) {
+  const ryuko::test::Scratch scratch{"watch-nested-include-edit"};
+
+  const auto main = ryuko::test::nestedIncludes(scratch);
+
+  std::unique_ptr<ryuko::compilation::Sink> latest;
+  ryuko::Watcher watcher{
+      VK_NULL_HANDLE,
+      [&latest](const std::filesystem::path &,
+                std::unique_ptr<ryuko::compilation::Sink> sink) {
+        latest = std::move(sink);
+      },
+      ryuko::compilation::Profile::Fast, ryuko::WorkerPool::shared(),
+      [] { return std::make_unique<ryuko::compilation::SpirvSink>(); }};
+
+  CHECK(watcher.watch(main));
+  CHECK(latest && hasUniform(*latest, "oldTex"));
+
+  scratch.write("b.glsl", R"(#include "c.glsl"
+
+layout (set = 0, binding = 0) uniform sampler2D newTex;
+)");
+
+  latest.reset();
+  CHECK(watcher.poll() == 1);
+  CHECK(latest && hasUniform(*latest, "newTex"));
+  CHECK(latest && !hasUniform(*latest, "oldTex"));
+
+  scratch.write("c.glsl", R"(vec4 extra(vec4 v) {
+    return v * 2.0;
+}
+)");
+
+  CHECK(watcher.poll() == 1);
+}
+
+//  a fragment stage that no longer compiles keeps the last good build
+TEST(watchBrokenFragmentEdit) {
+  const ryuko::test::Scratch scratch{"watch-broken-fragment-edit"};
+
+  const auto main = scratch.write("main.glsl", ryuko::test::BothStages);
+
+  size_t builds = 0;
+  ryuko::Watcher watcher{
+      VK_NULL_HANDLE,
+      [&builds](const std::filesystem::path &,
+                std::unique_ptr<ryuko::compilation::Sink>) { builds++; },
+      ryuko::compilation::Profile::Fast, ryuko::WorkerPool::shared(),
+      [] { return std::make_unique<ryuko::compilation::SpirvSink>(); }};
+
+  CHECK(watcher.watch(main));
+  CHECK(builds == 1);
+
+  scratch.write("main.glsl", ryuko::test::BrokenFragment);
+
+  CHECK(watcher.poll() == 0);
+  CHECK(builds == 1);
+
+  scratch.write("main.glsl", ryuko::test::BothStages);
+
+  CHECK(watcher.poll() == 1);
+  CHECK(builds == 2);
+}
+
+//  an include deleted while watched rebuilds nothing until it is back
+TEST(watchIncludeDeleted) {
+  const ryuko::test::Scratch scratch{"watch-include-deleted"};
+  const auto main = ryuko::test::nestedIncludes(scratch);
+
+  std::unique_ptr<ryuko::compilation::Sink> latest;
+  size_t builds = 0;
+  ryuko::Watcher watcher{
+      VK_NULL_HANDLE,
+      [&latest, &builds](const std::filesystem::path &,
+                         std::unique_ptr<ryuko::compilation::Sink> sink) {
+        latest = std::move(sink);
+        builds++;
+      },
+      ryuko::compilation::Profile::Fast, ryuko::WorkerPool::shared(),
+      [] { return std::make_unique<ryuko::compilation::SpirvSink>(); }};
+
+  CHECK(watcher.watch(main));
+  CHECK(builds == 1);
+
+  CHECK(std::filesystem::remove(scratch.path("b.glsl")));
+
+  CHECK(watcher.poll() == 0);
+  CHECK(builds == 1);
+  CHECK(latest && hasUniform(*latest, "oldTex"));
+
+  scratch.write("b.glsl",
+                "layout (set = 0, binding = 0) uniform sampler2D newTex;\n");
+
+  CHECK(watcher.poll() == 1);
+  CHECK(builds == 2);
+  CHECK(latest && hasUniform(*latest, "newTex"));
+}
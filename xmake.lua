@@ -1,4 +1,5 @@
 local enable_exceptions = true
+local enable_avx2 = false
 
 set_toolset("cxx", "clang")
 set_toolset("ld", "clang++")
@@ -11,6 +12,10 @@ set_kind("static")
 
 add_cxxflags("-std=c++20", "-msse2", "-fPIC")
 
+if enable_avx2 then
+    add_cxxflags("-mavx2")
+end
+
 if enable_exceptions then
     add_cxxflags("-fexceptions")
     add_defines("USE_EXCEPTIONS")